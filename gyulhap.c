@@ -1,118 +1,190 @@
 #include "raylib.h"
+#include "gyulhap_core.h"
+#include "gyulhap_catalog.h"
+#include "gyulhap_seed.h"
+#include "gyulhap_prefetch.h"
+#include "gyulhap_input.h"
+#include "gyulhap_render.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_replay.h"
+#include "gyulhap_stats.h"
+#include "gyulhap_sim.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <stdbool.h>
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
-#define NUM_TILES 9
-#define TOTAL_COMBINATIONS 27
 #define TILE_SIDE_LENGTH 150
 #define H_MARGIN 125
 #define V_MARGIN 100
 #define SPACING 50
-#define MAX_SELECTED_TILES 3
+#define TARGET_FPS 60
+#define FIRST_GAME 42 // Game numbers fully determine the board
+#define IDLE_REDRAW_SECONDS 1.0 // Redraw now and then even when nothing changed
+#define METRICS_OVERLAY_SECONDS 0.5
+#define METRICS_EXPORT_SECONDS 10.0
 #define SELECTION_BORDER_WIDTH 5
 #define SELECTION_BORDER_COLOR GOLD
+#define ATLAS_COLUMNS 9 // 27 tiles as 3 rows, selected copies in 3 more
+#define ATLAS_ROWS 6
+#define HELP_LINES 9
+#define NUM_COLOR_OPTIONS 5
+#define NUM_TIMER_OPTIONS 5
 
-typedef enum { BG_WHITE, BG_GREY, BG_BLACK } BackgroundColor;
-typedef enum { S_CIRCLE, S_SQUARE, S_TRIANGLE } Shape;
-typedef enum { C_RED, C_YELLOW, C_BLUE } ShapeColor;
+typedef enum { SCREEN_START, SCREEN_HELP, SCREEN_SETTINGS, SCREEN_GAME, SCREEN_ENDING } Screen;
 
 typedef struct {
-    BackgroundColor backgroundColor;
-    Shape shape;
-    ShapeColor shapeColor;
-} Tile;
+    const char *text;
+    Vector2 position;
+    float fontSize;
+    float spacing;
+} TextLayout;
 
-Color bgColor = BEIGE;
-bool areAllSameOrAllDifferent(int value1, int value2, int value3);
-bool compareTiles(Tile *tiles1, Tile *tiles2);
-bool isValidHap(Tile tile1, Tile tile2, Tile tile3);
-int countAllHaps(Tile *boardTiles, int numTiles);
-void findAllHaps(Tile *boardTiles, int numTiles, Tile (*haps)[3]);
-void shuffleArray(Tile *array, int size);
-void drawTile(Tile tile, int x, int y, int size);
-bool isTileSelected(Tile tile, Tile *selectedTiles, int numSelectedTiles);
-void handleTileSelection(Tile *tiles, int numTiles, Tile *selectedTiles, int *numSelectedTiles, Tile (*haps)[3], Tile (*duplicates)[3], int *numHaps, int *numDuplicates, int *remainingHaps, int *score);
-void drawTileWithBorder(Tile tile, int x, int y, int size, Color borderColor, int borderWidth);
-bool isValidGyul(int remainingHaps);
-void handleGyul(int remainingHaps, int *score, bool *isGameOver);
-void startScreen(bool *startGame, bool *showHelp, bool *showSettings);
-void helpScreen(bool *showHelp);
-void settingsScreen(bool *showSettings);
-void endingScreen(int score, bool *playAgain, bool *quitToMenu);
-
-bool areAllSameOrAllDifferent(int value1, int value2, int value3) {
-    return (value1 == value2 && value2 == value3) || (value1 != value2 && value2 != value3 && value1 != value3);
-}
+typedef struct {
+    Rectangle rect;
+    TextLayout label;
+} ButtonLayout;
 
-bool compareTiles(Tile *tiles1, Tile *tiles2) {
-    for (int i = 0; i < 3; i++) {
-        bool found = false;
-        for (int j = 0; j < 3; j++) {
-            if (tiles1[i].backgroundColor == tiles2[j].backgroundColor &&
-                tiles1[i].shape == tiles2[j].shape &&
-                tiles1[i].shapeColor == tiles2[j].shapeColor) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            return false;
-        }
-    }
-    return true;
-}
+// Each screen's geometry and text metrics, measured once by layoutScreens
+typedef struct {
+    TextLayout title;
+    ButtonLayout play;
+    ButtonLayout help;
+    ButtonLayout settings;
+    TextLayout credit;
+} StartLayout;
 
-bool isValidHap(Tile tile1, Tile tile2, Tile tile3) {
-    bool backgroundColorCondition = areAllSameOrAllDifferent(tile1.backgroundColor, tile2.backgroundColor, tile3.backgroundColor);
-    bool shapeCondition = areAllSameOrAllDifferent(tile1.shape, tile2.shape, tile3.shape);
-    bool shapeColorCondition = areAllSameOrAllDifferent(tile1.shapeColor, tile2.shapeColor, tile3.shapeColor);
-    return backgroundColorCondition && shapeCondition && shapeColorCondition;
-}
+typedef struct {
+    TextLayout title;
+    TextLayout lines[HELP_LINES];
+    TileId examples[2][3];
+    Vector2 examplePositions[2][3];
+    TextLayout back;
+} HelpLayout;
 
-int countAllHaps(Tile *boardTiles, int numTiles) {
-    int numHaps = 0;
+typedef struct {
+    TextLayout title;
+    TextLayout colorLabel;
+    Color colors[NUM_COLOR_OPTIONS];
+    Rectangle colorRects[NUM_COLOR_OPTIONS];
+    TextLayout difficultyLabel;
+    TextLayout noCatalog;
+    int difficultyOptions[CATALOG_MAX_HAPS + 2];
+    char difficultyText[CATALOG_MAX_HAPS + 2][4];
+    ButtonLayout difficultyButtons[CATALOG_MAX_HAPS + 2];
+    int numDifficultyOptions;
+    TextLayout timerLabel;
+    int timerOptions[NUM_TIMER_OPTIONS];
+    ButtonLayout timerButtons[NUM_TIMER_OPTIONS];
+    TextLayout back;
+} SettingsLayout;
 
-    for (int i = 0; i < numTiles - 2; i++) {
-        for (int j = i + 1; j < numTiles - 1; j++) {
-            for (int k = j + 1; k < numTiles; k++) {
-                if (isValidHap(boardTiles[i], boardTiles[j], boardTiles[k])) {
-                    numHaps++;
-                }
-            }
-        }
-    }
+typedef struct {
+    TextLayout title;
+    TextLayout timeUp; // Title of a timed round that ran out
+    char scoreText[20];
+    TextLayout score;
+    char bestText[20];
+    TextLayout best;
+    ButtonLayout playAgain;
+    ButtonLayout quitToMenu;
+} EndingLayout;
 
-    return numHaps;
+Color bgColor = BEIGE;
+BoardCatalog catalog;
+RoundPrefetch roundPrefetch; // Next rounds, dealt on a background thread
+int targetHaps = -1; // Any board unless a difficulty is picked
+int timeLimit = 0; // Timed mode's seconds per round, 0 for no clock
+uint64_t currentGame;
+const GridLayout boardGrid = {H_MARGIN, V_MARGIN, TILE_SIDE_LENGTH, SPACING, 3, 3};
+InputQueue inputQueue;
+RenderTexture2D tileAtlas; // Every tile, plain and selected, drawn once
+StartLayout startLayout;
+HelpLayout helpLayout;
+SettingsLayout settingsLayout;
+GameScene gameScene;
+EndingLayout endingLayout;
+Simulation simulation; // The rules, stepped on their own thread
+const SimSnapshot *shownState; // The simulation's latest, what the game screen draws
+uint32_t roundsStarted;
+GameHud gameHud;
+Renderer renderer; // raylib, see initRaylibRenderer
+FrameMetrics frameMetrics;
+uint64_t pendingInput; // Oldest press pushed but not yet shown on screen, 0 if none
+bool showMetrics = false; // F3
+char metricsText[NUM_METRICS][160];
+ReplayLog replayLog; // Every round, written by a background thread
+StatsStore statsStore; // Every finished round, per player, written by the simulation thread
+uint64_t localPlayer; // Hash of the login name, see localPlayerId
+pthread_t historyThread; // Compacts the stats at startup, see loadHistory
+bool historyRunning;
+int historyBest = INT_MIN; // Set once by historyThread, INT_MIN until then or without history
+int bestScore = INT_MIN; // Of this session's rounds and historyBest
+uint64_t localPlayerId(void);
+void *loadHistory(void *arg);
+void dealBoard(void);
+void drawTile(Tile tile, int x, int y, int size);
+void captureInput(InputQueue *queue);
+void handleInput(InputQueue *queue);
+void drawTileWithBorder(Tile tile, int x, int y, int size, Color borderColor, int borderWidth);
+void bakeTileAtlas(void);
+void drawTileSprite(TileId id, bool selected, int x, int y);
+TextLayout placeText(const char *text, float fontSize, float spacing, float x, float y);
+TextLayout centerText(const char *text, float fontSize, float spacing, float y);
+ButtonLayout makeButton(const char *text, Rectangle rect, float fontSize, float spacing);
+void initRaylibRenderer(Renderer *renderer);
+void drawText(const Renderer *renderer, const TextLayout *layout, Color color);
+void drawButton(const Renderer *renderer, const ButtonLayout *button, Color color);
+bool isButtonClicked(const ButtonLayout *button);
+void layoutScreens(void);
+void enterScreen(Screen next);
+Screen updateScreen(Screen screen, unsigned *dirty);
+void drawScreen(const Renderer *renderer, Screen screen);
+void drawMetricsOverlay(const Renderer *renderer);
+
+// Stats are kept per login, there are no accounts
+uint64_t localPlayerId(void) {
+    const char *name = getenv("USER");
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for (const char *c = name != NULL ? name : ""; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    return hash;
 }
 
-void findAllHaps(Tile *boardTiles, int numTiles, Tile (*haps)[3]) {
-    int numHaps = 0;
-
-    for (int i = 0;i < numTiles - 2; i++) {
-        for (int j = i + 1; j < numTiles - 1; j++) {
-            for (int k = j + 1; k < numTiles; k++) {
-                if (isValidHap(boardTiles[i], boardTiles[j], boardTiles[k])) {
-                    haps[numHaps][0] = boardTiles[i];
-                    haps[numHaps][1] = boardTiles[j];
-                    haps[numHaps][2] = boardTiles[k];
-                    numHaps++;
-                }
-            }
+// historyThread: compaction reads and fsyncs the whole log since the last
+// one, far too slow for a frame
+void *loadHistory(void *arg) {
+    StatsSummary summary;
+    PlayerStats history;
+    (void)arg;
+    if (compactStats(STATS_DIR, NULL) && openStatsSummary(&summary, STATS_DIR)) {
+        if (personalBest(&summary, localPlayer, &history)) {
+            __atomic_store_n(&historyBest, history.bestScore, __ATOMIC_RELEASE);
         }
+        closeStatsSummary(&summary);
     }
+    return NULL;
 }
 
-void shuffleArray(Tile *array, int size) {
-    for (int i = size - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        Tile temp = array[i];
-        array[i] = array[j];
-        array[j] = temp;
+// The next prepared round, nothing is dealt on this thread. Returns once
+// the simulation has started it, about a step later.
+void dealBoard(void) {
+    PreparedRound round;
+    popPreparedRound(&roundPrefetch, &round);
+    currentGame = round.gameNumber;
+
+    SimCommand start = {SIM_START, 0, monotonicNanos(), (uint64_t)timeLimit * 1000000000ULL, round.gameNumber, {0}};
+    memcpy(start.tiles, round.tiles, sizeof(start.tiles));
+    // A full ring drains within a step, and the wait below needs the round
+    while (!pushSimCommand(&simulation, &start)) {
+        WaitTime(SIM_TICK_NANOS / 1e9);
     }
+    shownState = awaitSimRound(&simulation, ++roundsStarted);
 }
 
 void drawTile(Tile tile, int x, int y, int size) {
@@ -164,91 +236,45 @@ void drawTile(Tile tile, int x, int y, int size) {
 
 }
 
-bool isTileSelected(Tile tile, Tile *selectedTiles, int numSelectedTiles) {
-    for (int i = 0; i < numSelectedTiles; i++) {
-        if (selectedTiles[i].backgroundColor == tile.backgroundColor &&
-            selectedTiles[i].shape == tile.shape &&
-            selectedTiles[i].shapeColor == tile.shapeColor) {
-            return true;
-        }
+// raylib only reports press edges per poll, so this runs once per frame
+// and queues whatever edges that poll saw, stamped with the poll time
+void captureInput(InputQueue *queue) {
+    Vector2 mousePosition = GetMousePosition();
+    uint64_t now = monotonicNanos();
+
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        pushInputEvent(queue, (InputEvent){POINTER_DOWN, mousePosition.x, mousePosition.y, now});
+    }
+    if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
+        pushInputEvent(queue, (InputEvent){POINTER_UP, mousePosition.x, mousePosition.y, now});
     }
-    return false;
 }
 
-void handleTileSelection(Tile *tiles, int numTiles, Tile *selectedTiles, int *numSelectedTiles, Tile (*haps)[3], Tile (*duplicates)[3], int *numHaps, int *numDuplicates, int *remainingHaps, int *score) {
-    Vector2 mousePosition = GetMousePosition();
+// Drains the queue in order: presses on a tile or the GYUL button go to the
+// simulation as commands, stamped with the time they were captured. The
+// simulation scores, logs and times them.
+void handleInput(InputQueue *queue) {
+    InputEvent event;
 
-    // Tile Selection
-    for (int i = 0; i < numTiles; i++) {
-        int tileX = H_MARGIN + ((i % 3) * SPACING) + (i % 3) * TILE_SIDE_LENGTH;
-        int tileY = V_MARGIN + ((i / 3) * SPACING) + (i / 3) * TILE_SIDE_LENGTH;
-
-        // Mouse Boundaries
-        if (mousePosition.x >= tileX && mousePosition.x <= tileX + TILE_SIDE_LENGTH &&
-            mousePosition.y >= tileY && mousePosition.y <= tileY + TILE_SIDE_LENGTH) {
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                if (isTileSelected(tiles[i], selectedTiles, *numSelectedTiles)) {
-                    for (int j = 0; j < *numSelectedTiles; j++) {
-                        if (selectedTiles[j].backgroundColor == tiles[i].backgroundColor &&
-                            selectedTiles[j].shape == tiles[i].shape &&
-                            selectedTiles[j].shapeColor == tiles[i].shapeColor) {
-                            for (int k = j; k < *numSelectedTiles - 1; k++) {
-                                selectedTiles[k] = selectedTiles[k + 1];
-                            }
-                            (*numSelectedTiles)--;
-                            break;
-                        }
-                    }
-                } else if (*numSelectedTiles < MAX_SELECTED_TILES) {
-                    selectedTiles[*numSelectedTiles] = tiles[i];
-                    (*numSelectedTiles)++;
-                }
-            }
+    while (popInputEvent(queue, &event)) {
+        if (event.type != POINTER_DOWN) {
+            continue;
         }
-    }
 
-    // Checking Puzzle Submission
-    if (*numSelectedTiles == 3) {
-        bool isValid = isValidHap(selectedTiles[0], selectedTiles[1], selectedTiles[2]);
-        bool isDuplicate = false;
-
-        // If Valid, check if already found
-        if (isValid) {
-            for (int i = 0; i < *numDuplicates; i++) {
-                if (compareTiles(selectedTiles, duplicates[i])) {
-                    isDuplicate = true;
-                    (*score)--; // Duplicate Answer
-                    break;
-                }
-            }
-            
-            // New Solution, move to found list
-            if (!isDuplicate) {
-                for (int i = 0; i < *numHaps; i++) {
-                    if (compareTiles(selectedTiles, haps[i])) {
-                        duplicates[*numDuplicates][0] = selectedTiles[0];
-                        duplicates[*numDuplicates][1] = selectedTiles[1];
-                        duplicates[*numDuplicates][2] = selectedTiles[2];
-                        (*numDuplicates)++;
-
-
-                        for (int j = i; j < *numHaps - 1; j++) {
-                            haps[j][0] = haps[j + 1][0];
-                            haps[j][1] = haps[j + 1][1];
-                            haps[j][2] = haps[j + 1][2];
-                        }
-
-                        (*numHaps)--;
-                        (*remainingHaps)--;
-                        (*score)++; // Right Answer
-                        break;
-                    }
-                }
+        int position = gridHitTest(&boardGrid, event.x, event.y);
+        SimCommand command = {SIM_TOGGLE, position, event.time, 0, 0, {0}};
+        if (position < 0) {
+            if (!isInsideRect(gameScene.gyulButton, event.x, event.y)) {
+                continue;
             }
-        } else {
-            (*score)--; // Wrong Answer
+            command.type = SIM_GYUL;
+        }
+        pushSimCommand(&simulation, &command);
+
+        // Latency runs until the frame showing the result is presented
+        if (pendingInput == 0) {
+            pendingInput = event.time;
         }
-        *numSelectedTiles = 0; // Reset selection
     }
 }
 
@@ -258,78 +284,109 @@ void drawTileWithBorder(Tile tile, int x, int y, int size, Color borderColor, in
     DrawRectangleLinesEx((Rectangle){x, y, size, size}, borderWidth, borderColor);
 }
 
-bool isValidGyul(int remainingHaps) {
-    return remainingHaps == 0;
+// Renders the 54 tile sprites into tileAtlas, needs the window to exist
+void bakeTileAtlas(void) {
+    tileAtlas = LoadRenderTexture(ATLAS_COLUMNS * TILE_SIDE_LENGTH, ATLAS_ROWS * TILE_SIDE_LENGTH);
+
+    BeginTextureMode(tileAtlas);
+    ClearBackground(BLANK);
+    for (int id = 0; id < TOTAL_COMBINATIONS; id++) {
+        int x = (id % ATLAS_COLUMNS) * TILE_SIDE_LENGTH;
+        int y = (id / ATLAS_COLUMNS) * TILE_SIDE_LENGTH;
+        drawTile(tileFromId((TileId)id), x, y, TILE_SIDE_LENGTH);
+        drawTileWithBorder(tileFromId((TileId)id), x, y + (ATLAS_ROWS / 2) * TILE_SIDE_LENGTH, TILE_SIDE_LENGTH, SELECTION_BORDER_COLOR, SELECTION_BORDER_WIDTH);
+    }
+    EndTextureMode();
 }
 
-void handleGyul(int remainingHaps, int *score, bool *isGameOver) {
-    Vector2 mousePosition = GetMousePosition();
+// One textured quad from the atlas. Consecutive sprites share the texture,
+// so raylib batches a whole board into a single draw call.
+void drawTileSprite(TileId id, bool selected, int x, int y) {
+    int cellX = (id % ATLAS_COLUMNS) * TILE_SIDE_LENGTH;
+    int cellY = (id / ATLAS_COLUMNS + (selected ? ATLAS_ROWS / 2 : 0)) * TILE_SIDE_LENGTH;
 
-    // Mouse Boundaries
-    if (mousePosition.x >= 300 && mousePosition.x <= 500 &&
-        mousePosition.y >= 700 && mousePosition.y <= 750) {
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            if (isValidGyul(remainingHaps)) {
-                (*score) += 3;
-                (*isGameOver) = true;
-            } else {
-                (*score) -= 1;
-            }
-        }
-    }
+    // Render textures are stored bottom-up, hence the flipped source
+    Rectangle source = {cellX, tileAtlas.texture.height - cellY - TILE_SIDE_LENGTH, TILE_SIDE_LENGTH, -TILE_SIDE_LENGTH};
+    DrawTextureRec(tileAtlas.texture, source, (Vector2){x, y}, WHITE);
+}
+
+// Text placed once when its screen is laid out
+TextLayout placeText(const char *text, float fontSize, float spacing, float x, float y) {
+    return (TextLayout){text, {x, y}, fontSize, spacing};
+}
+
+TextLayout centerText(const char *text, float fontSize, float spacing, float y) {
+    Vector2 size = MeasureTextEx(GetFontDefault(), text, fontSize, spacing);
+    return placeText(text, fontSize, spacing, (WINDOW_WIDTH - size.x) / 2, y);
+}
+
+ButtonLayout makeButton(const char *text, Rectangle rect, float fontSize, float spacing) {
+    Vector2 size = MeasureTextEx(GetFontDefault(), text, fontSize, spacing);
+    TextLayout label = placeText(text, fontSize, spacing, rect.x + (rect.width - size.x) / 2, rect.y + (rect.height - size.y) / 2);
+    return (ButtonLayout){rect, label};
+}
+
+// raylib backend for the Renderer interface
+#define TO_COLOR(c) ((Color){(c).r, (c).g, (c).b, (c).a})
+#define TO_RENDER_COLOR(c) ((RenderColor){(c).r, (c).g, (c).b, (c).a})
+#define TO_RENDER_RECT(r) ((RenderRect){(r).x, (r).y, (r).width, (r).height})
+
+void raylibClear(void *context, RenderColor color) {
+    ClearBackground(TO_COLOR(color));
+}
+
+void raylibRect(void *context, RenderRect rect, RenderColor color) {
+    DrawRectangleRec((Rectangle){rect.x, rect.y, rect.width, rect.height}, TO_COLOR(color));
+}
+
+void raylibRectLines(void *context, RenderRect rect, float thickness, RenderColor color) {
+    DrawRectangleLinesEx((Rectangle){rect.x, rect.y, rect.width, rect.height}, thickness, TO_COLOR(color));
+}
+
+void raylibText(void *context, const char *text, float x, float y, float fontSize, float spacing, RenderColor color) {
+    DrawTextEx(GetFontDefault(), text, (Vector2){x, y}, fontSize, spacing, TO_COLOR(color));
 }
 
-void startScreen(bool *startGame, bool *showHelp, bool *showSettings) {
-    Vector2 gameNameSize = MeasureTextEx(GetFontDefault(), "GYUL HAP", 120, 1);
+void raylibTile(void *context, TileId id, bool selected, float x, float y) {
+    drawTileSprite(id, selected, x, y);
+}
+
+float raylibMeasureText(void *context, const char *text, float fontSize, float spacing) {
+    return MeasureTextEx(GetFontDefault(), text, fontSize, spacing).x;
+}
+
+void initRaylibRenderer(Renderer *renderer) {
+    *renderer = (Renderer){raylibClear, raylibRect, raylibRectLines, raylibText, raylibTile, raylibMeasureText, NULL};
+}
+
+void drawText(const Renderer *renderer, const TextLayout *layout, Color color) {
+    renderer->text(renderer->context, layout->text, layout->position.x, layout->position.y, layout->fontSize, layout->spacing, TO_RENDER_COLOR(color));
+}
+
+void drawButton(const Renderer *renderer, const ButtonLayout *button, Color color) {
+    renderer->rect(renderer->context, TO_RENDER_RECT(button->rect), TO_RENDER_COLOR(color));
+    drawText(renderer, &button->label, BLACK);
+}
+
+bool isButtonClicked(const ButtonLayout *button) {
+    return IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(GetMousePosition(), button->rect);
+}
+
+// Measures every static screen once, after the window exists
+void layoutScreens(void) {
     Vector2 buttonSize = {300, 60};
     Vector2 buttonSpacing = {0, 20};
+    float buttonX = (WINDOW_WIDTH - buttonSize.x) / 2;
 
-    Rectangle playButton = {(WINDOW_WIDTH - buttonSize.x) / 2, WINDOW_HEIGHT / 2 - buttonSize.y - buttonSpacing.y, buttonSize.x, buttonSize.y};
-    Rectangle helpButton = {(WINDOW_WIDTH - buttonSize.x) / 2, WINDOW_HEIGHT / 2, buttonSize.x, buttonSize.y};
-    Rectangle settingsButton = {(WINDOW_WIDTH - buttonSize.x) / 2, WINDOW_HEIGHT / 2 + buttonSize.y + buttonSpacing.y, buttonSize.x, buttonSize.y};
-    
-    Vector2 playTextSize = MeasureTextEx(GetFontDefault(), "Play Game", 30, 1);
-    Vector2 helpTextSize = MeasureTextEx(GetFontDefault(), "Help", 30, 1);
-    Vector2 settingsTextSize = MeasureTextEx(GetFontDefault(), "Settings", 30, 1);
-    
-    char *creditText = "Made with raylib - Kevin Liu 2024";
-    Vector2 creditTextSize = MeasureTextEx(GetFontDefault(), creditText, 20, 1);
-    
-    while (!WindowShouldClose() && !(*startGame) && !(*showHelp) && !(*showSettings)) {
-        BeginDrawing();
-        ClearBackground(bgColor);
-        
-        DrawTextEx(GetFontDefault(), "GYUL HAP", (Vector2){(WINDOW_WIDTH - gameNameSize.x) / 2, 120}, 120, 5, BLACK);
-        
-        DrawRectangleRec(playButton, LIGHTGRAY);
-        DrawTextEx(GetFontDefault(), "Play Game", (Vector2){playButton.x + (playButton.width - playTextSize.x) / 2, playButton.y + (playButton.height - playTextSize.y) / 2}, 30, 1.5, BLACK);
-        
-        DrawRectangleRec(helpButton, LIGHTGRAY);
-        DrawTextEx(GetFontDefault(), "Help", (Vector2){helpButton.x + (helpButton.width - helpTextSize.x) / 2, helpButton.y + (helpButton.height - helpTextSize.y) / 2}, 30, 1.5, BLACK);
-        
-        DrawRectangleRec(settingsButton, LIGHTGRAY);
-        DrawTextEx(GetFontDefault(), "Settings", (Vector2){settingsButton.x + (settingsButton.width - settingsTextSize.x) / 2, settingsButton.y + (settingsButton.height - settingsTextSize.y) / 2}, 30, 1.5, BLACK);
-        
-        DrawTextEx(GetFontDefault(), creditText, (Vector2){(WINDOW_WIDTH - creditTextSize.x) / 2, WINDOW_HEIGHT - creditTextSize.y - 20}, 20, 1, GRAY);
-        
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            Vector2 mousePos = GetMousePosition();
-            if (CheckCollisionPointRec(mousePos, playButton)) {
-                *startGame = true;
-            } else if (CheckCollisionPointRec(mousePos, helpButton)) {
-                *showHelp = true;
-            } else if (CheckCollisionPointRec(mousePos, settingsButton)) {
-                *showSettings = true;
-            }
-        }
-        
-        EndDrawing();
-    }
-}
+    // Start
+    startLayout.title = centerText("GYUL HAP", 120, 5, 120);
+    startLayout.play = makeButton("Play Game", (Rectangle){buttonX, WINDOW_HEIGHT / 2 - buttonSize.y - buttonSpacing.y, buttonSize.x, buttonSize.y}, 30, 1.5);
+    startLayout.help = makeButton("Help", (Rectangle){buttonX, WINDOW_HEIGHT / 2, buttonSize.x, buttonSize.y}, 30, 1.5);
+    startLayout.settings = makeButton("Settings", (Rectangle){buttonX, WINDOW_HEIGHT / 2 + buttonSize.y + buttonSpacing.y, buttonSize.x, buttonSize.y}, 30, 1.5);
+    startLayout.credit = centerText("Made with raylib - Kevin Liu 2024", 20, 1, WINDOW_HEIGHT - MeasureTextEx(GetFontDefault(), "Made with raylib - Kevin Liu 2024", 20, 1).y - 20);
 
-void helpScreen(bool *showHelp) {
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), "Help", 60, 2);
-    char *helpText[] = {
+    // Help
+    static const char *helpText[HELP_LINES] = {
         "GYUL HAP is a puzzle game where you need to find HAPs and GYUL.",
         "A HAP is a set of 3 tiles that satisfies the following condition:",
         "- The tile properties must ALL match or ALL be different",
@@ -340,275 +397,357 @@ void helpScreen(bool *showHelp) {
         "Example HAPs:",
         ""
     };
-    int numLines = sizeof(helpText) / sizeof(helpText[0]);
-    Vector2 textSize = MeasureTextEx(GetFontDefault(), helpText[0], 20, 1.5);
-    float textSpacing = 10;
-    float exampleSpacing = 20;
-    
-    Tile exampleHap1[3] = {
-        {BG_WHITE, S_CIRCLE, C_RED},
-        {BG_WHITE, S_SQUARE, C_RED},
-        {BG_WHITE, S_TRIANGLE, C_RED}
-    };
-    
-    Tile exampleHap2[3] = {
-        {BG_WHITE, S_CIRCLE, C_RED},
-        {BG_GREY, S_SQUARE, C_YELLOW},
-        {BG_BLACK, S_TRIANGLE, C_BLUE}
+    static const Tile exampleHaps[2][3] = {
+        {{BG_WHITE, S_CIRCLE, C_RED}, {BG_WHITE, S_SQUARE, C_RED}, {BG_WHITE, S_TRIANGLE, C_RED}},
+        {{BG_WHITE, S_CIRCLE, C_RED}, {BG_GREY, S_SQUARE, C_YELLOW}, {BG_BLACK, S_TRIANGLE, C_BLUE}}
     };
-    
-    while (!WindowShouldClose() && *showHelp) {
-        BeginDrawing();
-        ClearBackground(bgColor);
-        
-        DrawTextEx(GetFontDefault(), "Help", (Vector2){(WINDOW_WIDTH - titleSize.x) / 2, 50}, 60, 2, BLACK);
-        
-        for (int i = 0; i < numLines; i++) {
-            DrawTextEx(GetFontDefault(), helpText[i], (Vector2){50, 150 + i * (textSize.y + textSpacing)}, 20, 1.5, BLACK);
-        }
-        
-        float exampleWidth = 3 * TILE_SIDE_LENGTH + 2 * exampleSpacing;
-        float exampleY = 100 + (numLines + 1) * (textSize.y + textSpacing);
-        float exampleX = (WINDOW_WIDTH - exampleWidth) / 2;
-        
-        for (int i = 0; i < 3; i++) {
-            drawTile(exampleHap1[i], exampleX + i * (TILE_SIDE_LENGTH + exampleSpacing), exampleY, TILE_SIDE_LENGTH);
-        }
-        
-        exampleY += TILE_SIDE_LENGTH + exampleSpacing;
+    float lineHeight = MeasureTextEx(GetFontDefault(), helpText[0], 20, 1.5).y + 10;
+    float exampleSpacing = 20;
+    float exampleX = (WINDOW_WIDTH - (3 * TILE_SIDE_LENGTH + 2 * exampleSpacing)) / 2;
+    float exampleY = 100 + (HELP_LINES + 1) * lineHeight;
+
+    helpLayout.title = centerText("Help", 60, 2, 50);
+    for (int i = 0; i < HELP_LINES; i++) {
+        helpLayout.lines[i] = placeText(helpText[i], 20, 1.5, 50, 150 + i * lineHeight);
+    }
+    for (int e = 0; e < 2; e++) {
         for (int i = 0; i < 3; i++) {
-            drawTile(exampleHap2[i], exampleX + i * (TILE_SIDE_LENGTH + exampleSpacing), exampleY, TILE_SIDE_LENGTH);
+            helpLayout.examples[e][i] = tileToId(exampleHaps[e][i]);
+            helpLayout.examplePositions[e][i] = (Vector2){exampleX + i * (TILE_SIDE_LENGTH + exampleSpacing), exampleY + e * (TILE_SIDE_LENGTH + exampleSpacing)};
         }
-        
-        DrawText("Press 'H' to go back", (WINDOW_WIDTH / 2) - MeasureTextEx(GetFontDefault(), "Press 'H' to go back", 20, 1.5).x / 2, WINDOW_HEIGHT - 50, 20, GRAY);
-        
-        if (IsKeyPressed(KEY_H)) {
-            *showHelp = false;
+    }
+    helpLayout.back = centerText("Press 'H' to go back", 20, 2, WINDOW_HEIGHT - 50);
+
+    // Settings
+    static const Color colorOptions[NUM_COLOR_OPTIONS] = {BEIGE, LIGHTGRAY, SKYBLUE, PINK, ORANGE};
+    Vector2 optionSize = {50, 50};
+    Vector2 optionSpacing = {20, 20};
+
+    settingsLayout.title = centerText("Settings", 60, 2, 100);
+    settingsLayout.colorLabel = centerText("Change background color:", 30, 2, WINDOW_HEIGHT / 2 - 100);
+    for (int i = 0; i < NUM_COLOR_OPTIONS; i++) {
+        settingsLayout.colors[i] = colorOptions[i];
+        settingsLayout.colorRects[i] = (Rectangle){(WINDOW_WIDTH - (NUM_COLOR_OPTIONS * optionSize.x + (NUM_COLOR_OPTIONS - 1) * optionSpacing.x)) / 2 + i * (optionSize.x + optionSpacing.x), WINDOW_HEIGHT / 2, optionSize.x, optionSize.y};
+    }
+
+    // Difficulty is the exact number of haps on the board, picked from the catalogue
+    settingsLayout.difficultyLabel = centerText("Haps on the board:", 30, 2, WINDOW_HEIGHT / 2 + 100);
+    settingsLayout.noCatalog = centerText("Run 'make catalog' to choose the number of haps", 20, 1.5, WINDOW_HEIGHT / 2 + 160);
+    int numOptions = 0;
+    settingsLayout.difficultyOptions[numOptions++] = -1;
+    for (int k = 0; k <= CATALOG_MAX_HAPS; k++) {
+        if (catalogCount(&catalog, k) > 0) {
+            settingsLayout.difficultyOptions[numOptions++] = k;
         }
-        
-        EndDrawing();
     }
-}
+    settingsLayout.numDifficultyOptions = numOptions;
+    for (int i = 0; i < numOptions; i++) {
+        int option = settingsLayout.difficultyOptions[i];
+        Rectangle rect = {(WINDOW_WIDTH - (numOptions * optionSize.x + (numOptions - 1) * optionSpacing.x)) / 2 + i * (optionSize.x + optionSpacing.x), WINDOW_HEIGHT / 2 + 160, optionSize.x, optionSize.y};
+        snprintf(settingsLayout.difficultyText[i], sizeof(settingsLayout.difficultyText[i]), option < 0 ? "Any" : "%d", option);
+        settingsLayout.difficultyButtons[i] = makeButton(settingsLayout.difficultyText[i], rect, 20, 1.5);
+    }
 
-void settingsScreen(bool *showSettings) {
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), "Settings", 60, 2);
-    char *settingsText = "Change background color:";
-    Vector2 settingsTextSize = MeasureTextEx(GetFontDefault(), settingsText, 30, 2);
-    
-    Color colorOptions[5] = {BEIGE, LIGHTGRAY, SKYBLUE, PINK, ORANGE};
-    Rectangle colorRects[5];
-    Vector2 colorRectsSize = {50, 50};
-    Vector2 colorRectsSpacing = {20, 20};
-    
-    for (int i = 0; i < 5; i++) {
-        colorRects[i].width = colorRectsSize.x;
-        colorRects[i].height = colorRectsSize.y;
-        colorRects[i].x = (WINDOW_WIDTH - (5 * colorRectsSize.x + 4 * colorRectsSpacing.x)) / 2 + i * (colorRectsSize.x + colorRectsSpacing.x);
-        colorRects[i].y = WINDOW_HEIGHT / 2;
+    // Timed mode, seconds per round
+    static const int timerOptions[NUM_TIMER_OPTIONS] = {0, 30, 60, 120, 180};
+    static const char *timerText[NUM_TIMER_OPTIONS] = {"Off", "30s", "60s", "120s", "180s"};
+    Vector2 timerSize = {70, 40};
+    settingsLayout.timerLabel = centerText("Round timer:", 30, 2, WINDOW_HEIGHT / 2 + 225);
+    for (int i = 0; i < NUM_TIMER_OPTIONS; i++) {
+        Rectangle rect = {(WINDOW_WIDTH - (NUM_TIMER_OPTIONS * timerSize.x + (NUM_TIMER_OPTIONS - 1) * optionSpacing.x)) / 2 + i * (timerSize.x + optionSpacing.x), WINDOW_HEIGHT / 2 + 270, timerSize.x, timerSize.y};
+        settingsLayout.timerOptions[i] = timerOptions[i];
+        settingsLayout.timerButtons[i] = makeButton(timerText[i], rect, 20, 1.5);
     }
-    
-    while (!WindowShouldClose() && *showSettings) {
-        BeginDrawing();
-        ClearBackground(bgColor);
-        
-        DrawTextEx(GetFontDefault(), "Settings", (Vector2){(WINDOW_WIDTH - titleSize.x) / 2, 100}, 60, 2, BLACK);
-        DrawTextEx(GetFontDefault(), settingsText, (Vector2){(WINDOW_WIDTH - settingsTextSize.x) / 2, WINDOW_HEIGHT / 2 - 100}, 30, 2, BLACK);
-        
-        for (int i = 0; i < 5; i++) {
-            DrawRectangleRec(colorRects[i], colorOptions[i]);
-            if (CheckCollisionPointRec(GetMousePosition(), colorRects[i]) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                bgColor = colorOptions[i];
+    settingsLayout.back = centerText("Press 'S' to go back", 20, 2, WINDOW_HEIGHT - 50);
+
+    // Game
+    initGameScene(&gameScene, &renderer, WINDOW_WIDTH, boardGrid, (RenderRect){300, 700, 200, 50});
+
+    // Ending, the score line is placed when the round ends
+    endingLayout.title = centerText("ROUND COMPLETE", 60, 2, 100);
+    endingLayout.timeUp = centerText("TIME'S UP", 60, 2, 100);
+    endingLayout.playAgain = makeButton("Play Again", (Rectangle){buttonX, WINDOW_HEIGHT / 2 - buttonSize.y - buttonSpacing.y, buttonSize.x, buttonSize.y}, 30, 2);
+    endingLayout.quitToMenu = makeButton("Quit To Menu", (Rectangle){buttonX, WINDOW_HEIGHT / 2, buttonSize.x, buttonSize.y}, 30, 2);
+}
+
+// Per-screen setup on the way in, everything else was laid out at startup
+void enterScreen(Screen next) {
+    switch (next) {
+        case SCREEN_GAME:
+            dealBoard();
+            initInputQueue(&inputQueue);
+            startGameHud(&gameHud, &gameScene, &renderer, &shownState->game, currentGame, targetHaps);
+            break;
+        case SCREEN_ENDING: {
+            // The simulation thread has recorded the round
+            int score = shownState->game.score;
+            int history = __atomic_load_n(&historyBest, __ATOMIC_ACQUIRE);
+            if (history > bestScore) {
+                bestScore = history;
             }
+            if (score > bestScore) {
+                bestScore = score;
+            }
+            snprintf(endingLayout.scoreText, sizeof(endingLayout.scoreText), "SCORE: %d", score);
+            endingLayout.score = centerText(endingLayout.scoreText, 40, 2, 200);
+            snprintf(endingLayout.bestText, sizeof(endingLayout.bestText), "BEST: %d", bestScore);
+            endingLayout.best = centerText(endingLayout.bestText, 30, 2, 250);
+            break;
         }
-        
-        DrawText("Press 'S' to go back", (WINDOW_WIDTH / 2) - MeasureTextEx(GetFontDefault(), "Press 'S' to go back", 20, 1.5).x / 2, WINDOW_HEIGHT - 50, 20, GRAY);
-        
-        if (IsKeyPressed(KEY_S)) {
-            *showSettings = false;
-        }
-        
-        EndDrawing();
+        default:
+            break;
     }
 }
 
-void endingScreen(int score, bool *playAgain, bool *quitToMenu) {
-    Vector2 titleSize = MeasureTextEx(GetFontDefault(), "ROUND COMPLETE", 60, 2);
-    char scoreText[20];
-    snprintf(scoreText, sizeof(scoreText), "SCORE: %d", score);
-    Vector2 scoreSize = MeasureTextEx(GetFontDefault(), scoreText, 40, 2);
-    
-    Vector2 buttonSize = {300, 60};
-    Vector2 buttonSpacing = {0, 20};
-    
-    Rectangle playAgainButton = {(WINDOW_WIDTH - buttonSize.x) / 2, WINDOW_HEIGHT / 2 - buttonSize.y - buttonSpacing.y, buttonSize.x, buttonSize.y};
-    Rectangle quitToMenuButton = {(WINDOW_WIDTH - buttonSize.x) / 2, WINDOW_HEIGHT / 2, buttonSize.x, buttonSize.y};
-    
-    Vector2 playAgainTextSize = MeasureTextEx(GetFontDefault(), "Play Again", 30, 2);
-    Vector2 quitToMenuTextSize = MeasureTextEx(GetFontDefault(), "Quit To Menu", 30, 2);
-    
-    while (!WindowShouldClose() && !(*playAgain) && !(*quitToMenu)) {
-        BeginDrawing();
-        ClearBackground(bgColor);
-        
-        DrawTextEx(GetFontDefault(), "ROUND COMPLETE", (Vector2){(WINDOW_WIDTH - titleSize.x) / 2, 100}, 60, 2, BLACK);
-        DrawTextEx(GetFontDefault(), scoreText, (Vector2){(WINDOW_WIDTH - scoreSize.x) / 2, 200}, 40, 2, BLACK);
-        
-        DrawRectangleRec(playAgainButton, LIGHTGRAY);
-        DrawTextEx(GetFontDefault(), "Play Again", (Vector2){playAgainButton.x + (playAgainButton.width - playAgainTextSize.x) / 2, playAgainButton.y + (playAgainButton.height - playAgainTextSize.y) / 2}, 30, 2, BLACK);
-        
-        DrawRectangleRec(quitToMenuButton, LIGHTGRAY);
-        DrawTextEx(GetFontDefault(), "Quit To Menu", (Vector2){quitToMenuButton.x + (quitToMenuButton.width - quitToMenuTextSize.x) / 2, quitToMenuButton.y + (quitToMenuButton.height - quitToMenuTextSize.y) / 2}, 30, 2, BLACK);
-        
-    
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            Vector2 mousePos = GetMousePosition();
-            if (CheckCollisionPointRec(mousePos, playAgainButton)) {
-                *playAgain = true;
-            } else if (CheckCollisionPointRec(mousePos, quitToMenuButton)) {
-                *quitToMenu = true;
+// Input and state changes for one frame, anything that needs a redraw is
+// added to dirty
+Screen updateScreen(Screen screen, unsigned *dirty) {
+    switch (screen) {
+        case SCREEN_START:
+            if (isButtonClicked(&startLayout.play)) {
+                return SCREEN_GAME;
+            } else if (isButtonClicked(&startLayout.help)) {
+                return SCREEN_HELP;
+            } else if (isButtonClicked(&startLayout.settings)) {
+                return SCREEN_SETTINGS;
             }
-        }
-        
-        EndDrawing();
+            break;
+        case SCREEN_HELP:
+            if (IsKeyPressed(KEY_H)) {
+                return SCREEN_START;
+            }
+            break;
+        case SCREEN_SETTINGS:
+            for (int i = 0; i < NUM_COLOR_OPTIONS; i++) {
+                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(GetMousePosition(), settingsLayout.colorRects[i])) {
+                    bgColor = settingsLayout.colors[i];
+                    *dirty |= DIRTY_SCREEN;
+                }
+            }
+            if (settingsLayout.numDifficultyOptions > 1) {
+                for (int i = 0; i < settingsLayout.numDifficultyOptions; i++) {
+                    if (isButtonClicked(&settingsLayout.difficultyButtons[i])) {
+                        targetHaps = settingsLayout.difficultyOptions[i];
+                        setPrefetchTarget(&roundPrefetch, targetHaps);
+                        *dirty |= DIRTY_SCREEN;
+                    }
+                }
+            }
+            for (int i = 0; i < NUM_TIMER_OPTIONS; i++) {
+                if (isButtonClicked(&settingsLayout.timerButtons[i])) {
+                    timeLimit = settingsLayout.timerOptions[i];
+                    *dirty |= DIRTY_SCREEN;
+                }
+            }
+            if (IsKeyPressed(KEY_S)) {
+                return SCREEN_START;
+            }
+            break;
+        case SCREEN_GAME:
+            captureInput(&inputQueue);
+            handleInput(&inputQueue);
+            shownState = latestSnapshot(&simulation);
+            *dirty |= updateGameHud(&gameHud, &shownState->game);
+            if (shownState->deadline != 0) {
+                *dirty |= updateHudTimer(&gameHud, (int)((shownState->remainingNanos + 999999999) / 1000000000));
+            }
+            if (shownState->game.isGameOver) {
+                return SCREEN_ENDING;
+            }
+            break;
+        case SCREEN_ENDING:
+            if (isButtonClicked(&endingLayout.playAgain)) {
+                return SCREEN_GAME;
+            } else if (isButtonClicked(&endingLayout.quitToMenu)) {
+                return SCREEN_START;
+            }
+            break;
     }
+    return screen;
 }
 
-int main(void) {
-    bool startGame = false; // CHANGE TO FALSE LATER
-    bool showHelp = false;
-    bool showSettings = false;
-    bool playAgain = false;
-    bool quitToMenu = false;
+void drawScreen(const Renderer *renderer, Screen screen) {
+    switch (screen) {
+        case SCREEN_START:
+            drawText(renderer, &startLayout.title, BLACK);
+            drawButton(renderer, &startLayout.play, LIGHTGRAY);
+            drawButton(renderer, &startLayout.help, LIGHTGRAY);
+            drawButton(renderer, &startLayout.settings, LIGHTGRAY);
+            drawText(renderer, &startLayout.credit, GRAY);
+            break;
+        case SCREEN_HELP:
+            drawText(renderer, &helpLayout.title, BLACK);
+            for (int i = 0; i < HELP_LINES; i++) {
+                drawText(renderer, &helpLayout.lines[i], BLACK);
+            }
+            for (int e = 0; e < 2; e++) {
+                for (int i = 0; i < 3; i++) {
+                    renderer->tile(renderer->context, helpLayout.examples[e][i], false, helpLayout.examplePositions[e][i].x, helpLayout.examplePositions[e][i].y);
+                }
+            }
+            drawText(renderer, &helpLayout.back, GRAY);
+            break;
+        case SCREEN_SETTINGS:
+            drawText(renderer, &settingsLayout.title, BLACK);
+            drawText(renderer, &settingsLayout.colorLabel, BLACK);
+            for (int i = 0; i < NUM_COLOR_OPTIONS; i++) {
+                renderer->rect(renderer->context, TO_RENDER_RECT(settingsLayout.colorRects[i]), TO_RENDER_COLOR(settingsLayout.colors[i]));
+            }
+            drawText(renderer, &settingsLayout.difficultyLabel, BLACK);
+            if (settingsLayout.numDifficultyOptions == 1) {
+                drawText(renderer, &settingsLayout.noCatalog, GRAY);
+            } else {
+                for (int i = 0; i < settingsLayout.numDifficultyOptions; i++) {
+                    drawButton(renderer, &settingsLayout.difficultyButtons[i], LIGHTGRAY);
+                    if (settingsLayout.difficultyOptions[i] == targetHaps) {
+                        renderer->rectLines(renderer->context, TO_RENDER_RECT(settingsLayout.difficultyButtons[i].rect), SELECTION_BORDER_WIDTH, TO_RENDER_COLOR(SELECTION_BORDER_COLOR));
+                    }
+                }
+            }
+            drawText(renderer, &settingsLayout.timerLabel, BLACK);
+            for (int i = 0; i < NUM_TIMER_OPTIONS; i++) {
+                drawButton(renderer, &settingsLayout.timerButtons[i], LIGHTGRAY);
+                if (settingsLayout.timerOptions[i] == timeLimit) {
+                    renderer->rectLines(renderer->context, TO_RENDER_RECT(settingsLayout.timerButtons[i].rect), SELECTION_BORDER_WIDTH, TO_RENDER_COLOR(SELECTION_BORDER_COLOR));
+                }
+            }
+            drawText(renderer, &settingsLayout.back, GRAY);
+            break;
+        case SCREEN_GAME:
+            drawGameScene(renderer, &gameScene, &gameHud, &shownState->game);
+            break;
+        case SCREEN_ENDING:
+            drawText(renderer, shownState->timedOut ? &endingLayout.timeUp : &endingLayout.title, BLACK);
+            drawText(renderer, &endingLayout.score, BLACK);
+            drawText(renderer, &endingLayout.best, DARKGRAY);
+            drawButton(renderer, &endingLayout.playAgain, LIGHTGRAY);
+            drawButton(renderer, &endingLayout.quitToMenu, LIGHTGRAY);
+            break;
+    }
+}
 
-    bool isGameOver = false;
-    unsigned int seed = 42;
-    srand(seed);
+// Percentiles of every metric in a small panel at the bottom left
+void drawMetricsOverlay(const Renderer *renderer) {
+    float lineHeight = 14;
+    float top = WINDOW_HEIGHT - NUM_METRICS * lineHeight - 10;
+
+    renderer->rect(renderer->context, (RenderRect){0, top - 5, WINDOW_WIDTH, NUM_METRICS * lineHeight + 15}, (RenderColor){0, 0, 0, 160});
+    for (int m = 0; m < NUM_METRICS; m++) {
+        renderer->text(renderer->context, metricsText[m], 10, top + m * lineHeight, 10, 1, (RenderColor){255, 255, 255, 255});
+    }
+}
 
+int main(void) {
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "GYUL HAP"); 
-    SetTargetFPS(60);
-    
-    Vector2 gyulTextSize = MeasureTextEx(GetFontDefault(), "GYUL", 50, 1);
-
-    // Make an array of the 27 unique tiles
-    Tile tilesArray[TOTAL_COMBINATIONS];
-    int index = 0;
-    for (int bg = 0; bg < 3; bg++) {
-        for (int shape = 0; shape < 3; shape++) {
-            for (int color = 0; color < 3; color++) {
-                tilesArray[index].backgroundColor = (BackgroundColor)bg;
-                tilesArray[index].shape = (Shape)shape;
-                tilesArray[index].shapeColor = (ShapeColor)color;
-                index++;
-            }
+    SetTargetFPS(TARGET_FPS);
+    bakeTileAtlas();
+    initRaylibRenderer(&renderer);
+
+    // Optional, without it difficulty can't be picked
+    openCatalog(&catalog, CATALOG_PATH);
+    if (!startRoundPrefetch(&roundPrefetch, &catalog, FIRST_GAME, targetHaps)) {
+        perror("startRoundPrefetch");
+        closeCatalog(&catalog);
+        UnloadRenderTexture(tileAtlas);
+        CloseWindow();
+        return 1;
+    }
+    openReplayLog(&replayLog, REPLAY_PATH);
+
+    // Optional too, the summary only supplies the best score shown at the
+    // end, so it is compacted off the frame loop and the first rounds may
+    // end before it is ready
+    localPlayer = localPlayerId();
+    bool recording = openStatsStore(&statsStore, STATS_DIR);
+    historyRunning = pthread_create(&historyThread, NULL, loadHistory, NULL) == 0;
+
+    // Rounds are scored, timed, logged and recorded on the simulation thread
+    initSimulation(&simulation, &replayLog, recording ? &statsStore : NULL, localPlayer);
+    if (!startSimulation(&simulation)) {
+        perror("startSimulation");
+        if (historyRunning) {
+            pthread_join(historyThread, NULL);
         }
+        closeStatsStore(&statsStore);
+        closeReplayLog(&replayLog);
+        stopRoundPrefetch(&roundPrefetch);
+        closeCatalog(&catalog);
+        UnloadRenderTexture(tileAtlas);
+        CloseWindow();
+        return 1;
     }
-    
+    shownState = latestSnapshot(&simulation);
+    layoutScreens();
+
+    // One loop for every screen: update, then draw only if something changed
+    Screen screen = SCREEN_START;
+    unsigned dirty = DIRTY_SCREEN;
+    double lastDrawn = 0;
+    double lastOverlay = 0;
+    double lastExport = GetTime();
+    resetFrameMetrics(&frameMetrics);
     while (!WindowShouldClose()) {
-        if (!startGame) {
-            startScreen(&startGame, &showHelp, &showSettings);
-        }
-
-        if (showHelp) {
-            helpScreen(&showHelp);
+        uint64_t frameStart = monotonicNanos();
+        Screen next = updateScreen(screen, &dirty);
+        if (next != screen) {
+            enterScreen(next);
+            screen = next;
+            dirty |= DIRTY_SCREEN;
         }
-
-        if (showSettings) {
-            settingsScreen(&showSettings);
+        if (IsKeyPressed(KEY_F3)) {
+            showMetrics = !showMetrics;
+            lastOverlay = 0;
+            dirty |= DIRTY_SCREEN;
         }
+        uint64_t updated = monotonicNanos();
+        recordLatency(&frameMetrics.histograms[METRIC_UPDATE], updated - frameStart);
 
-        if (startGame) {
-            isGameOver = false;
-            playAgain = false;
-
-            shuffleArray(tilesArray, TOTAL_COMBINATIONS);
-
-            // Randomly shuffle then select the first 9
-            Tile boardTiles[NUM_TILES];
-            for (int i = 0; i < NUM_TILES; i++) {
-                boardTiles[i] = tilesArray[i];
+        double now = GetTime();
+        if (showMetrics && now - lastOverlay >= METRICS_OVERLAY_SECONDS) {
+            for (int m = 0; m < NUM_METRICS; m++) {
+                formatHistogram(metricsText[m], sizeof(metricsText[m]), METRIC_NAMES[m], &frameMetrics.histograms[m]);
             }
+            lastOverlay = now;
+            dirty |= DIRTY_SCREEN;
+        }
+        if (now - lastExport >= METRICS_EXPORT_SECONDS) {
+            exportFrameMetrics(&frameMetrics, METRICS_PATH);
+            lastExport = now;
+        }
 
-            // Make empty array of selected tiles
-            Tile selectedTiles[MAX_SELECTED_TILES];
-            int numSelectedTiles = 0;
-
-            // Find all valid Haps
-            int numHaps = countAllHaps(boardTiles, NUM_TILES);
-            int numDuplicates = 0;
-            Tile (*haps)[3] = malloc(numHaps * sizeof(Tile[3]));
-            findAllHaps(boardTiles, NUM_TILES, haps);
-            Tile (*duplicates)[3] = malloc(numHaps * sizeof(Tile[3]));
-
-            // Score and tracking
-            int remainingHaps = numHaps;
-            int score = 0;
-
-            while (!WindowShouldClose() && !isGameOver)
-            {
-
-                // Update
-                handleTileSelection(boardTiles, NUM_TILES, selectedTiles, &numSelectedTiles, haps, duplicates, &numHaps, &numDuplicates, &remainingHaps, &score);
-                handleGyul(remainingHaps, &score, &isGameOver);
-
-                // Draw Loop
-                BeginDrawing();
-                ClearBackground(bgColor);
-                
-                DrawText(TextFormat("Remaining Haps: %d", remainingHaps), 10, 10, 20, BLACK);
-                DrawText(TextFormat("Score: %d", score), 10, 40, 20, BLACK);
-
-                // Draw tiles
-                for (int i = 0; i < NUM_TILES; i++) {
-                    int tileX = H_MARGIN + ((i % 3) * SPACING) + (i % 3) * TILE_SIDE_LENGTH;
-                    int tileY = V_MARGIN + ((i / 3) * SPACING) + (i / 3) * TILE_SIDE_LENGTH;
-                    
-                    if (isTileSelected(boardTiles[i], selectedTiles, numSelectedTiles)) {
-                        drawTileWithBorder(boardTiles[i], tileX, tileY, TILE_SIDE_LENGTH, SELECTION_BORDER_COLOR, SELECTION_BORDER_WIDTH);
-                    } else {
-                        drawTile(boardTiles[i], tileX, tileY, TILE_SIDE_LENGTH);
-                    }
-                }
-
-                // Draw GYUL button
-                DrawRectangle(300, 700, 200, 50, DARKBLUE);
-                DrawText("GYUL", 300 + (200 - gyulTextSize.x) / 2, 700 + (50 - gyulTextSize.y) / 2, 50, RAYWHITE);
-
-                EndDrawing();
+        if (dirty != 0 || now - lastDrawn >= IDLE_REDRAW_SECONDS) {
+            BeginDrawing();
+            renderer.clear(renderer.context, TO_RENDER_COLOR(bgColor));
+            drawScreen(&renderer, screen);
+            if (showMetrics) {
+                drawMetricsOverlay(&renderer);
             }
-
-            free(haps);
-            free(duplicates);
-
-            endingScreen(score, &playAgain, &quitToMenu);
-
-            if (playAgain) {
-                shuffleArray(tilesArray, TOTAL_COMBINATIONS);
-
-                for (int i = 0; i < NUM_TILES; i++) {
-                    boardTiles[i] = tilesArray[i];
-                }
-
-                numSelectedTiles = 0;
-
-                numHaps = countAllHaps(boardTiles, NUM_TILES);
-                numDuplicates = 0;
-                
-                haps = malloc(numHaps * sizeof(Tile[3]));
-                findAllHaps(boardTiles, NUM_TILES, haps);
-                duplicates = malloc(numHaps * sizeof(Tile[3]));
-
-                remainingHaps = numHaps;
-                score = 0;
-
-                startGame = true;
-                playAgain = false;
-            } else if (quitToMenu) {
-                startGame = false;
-                isGameOver = false;
+            recordLatency(&frameMetrics.histograms[METRIC_DRAW], monotonicNanos() - updated);
+            EndDrawing();
+            if (pendingInput != 0 && shownState->lastInput >= pendingInput) {
+                recordLatency(&frameMetrics.histograms[METRIC_INPUT_LATENCY], monotonicNanos() - pendingInput);
+                pendingInput = 0;
             }
+            dirty = 0;
+            lastDrawn = GetTime();
+        } else {
+            // The last frame stays up, EndDrawing would have polled and waited
+            PollInputEvents();
+            WaitTime(1.0 / TARGET_FPS);
         }
+        recordLatency(&frameMetrics.histograms[METRIC_FRAME], monotonicNanos() - frameStart);
     }
+    exportFrameMetrics(&frameMetrics, METRICS_PATH);
 
+    stopSimulation(&simulation); // Before the logs it writes to
+    if (historyRunning) {
+        pthread_join(historyThread, NULL);
+    }
+    closeReplayLog(&replayLog);
+    closeStatsStore(&statsStore);
+    stopRoundPrefetch(&roundPrefetch);
+    closeCatalog(&catalog);
+    UnloadRenderTexture(tileAtlas);
     CloseWindow();
 
     return 0;
@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_core.h"
+#include "gyulhap_engine.h"
+#include "gyulhap_pool.h"
+#include "gyulhap_rng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Hap-count statistics over every board (-e) or a random sample, spread
+// over all cores.
+//
+// Solve order (-o): the fewest leading tiles, in reading order, that
+// already hold a hap, i.e. how far a left-to-right scan has to go before
+// the first hap exists. Boards without haps are not counted.
+//
+// Sampled boards come in blocks of CHUNK_SIZE, each dealt from a fresh deck
+// and an RNG seeded from the seed and the block number, so a seed gives the
+// same boards however work stealing splits them between threads.
+
+#define CHUNK_SIZE 16384
+
+typedef struct {
+    GyulRng rng;
+    TileId deck[MAX_VARIANT_TILES];
+    uint64_t boards;
+    uint64_t histogram[MAX_VARIANT_HAPS + 1];
+    uint64_t firstHapDepth[MAX_BOARD_SIZE + 1];
+    char padding[64];
+} WorkerStats;
+
+typedef struct {
+    const GyulVariant *variant;
+    bool exhaustive;
+    bool solveOrder;
+    uint64_t seed;
+    WorkerStats *workers;
+} Analysis;
+
+static void recordSolveOrder(WorkerStats *stats, const GyulVariant *variant, const TileId *boardTiles) {
+    uint8_t hapPositions[MAX_VARIANT_HAPS][3];
+    int numHaps = variant->findHaps(boardTiles, hapPositions);
+    if (numHaps == 0) {
+        return;
+    }
+
+    int depth = MAX_BOARD_SIZE;
+    for (int h = 0; h < numHaps; h++) {
+        if (hapPositions[h][2] + 1 < depth) {
+            depth = hapPositions[h][2] + 1;
+        }
+    }
+    stats->firstHapDepth[depth]++;
+}
+
+// Boards [begin, end) in colex rank order, classic game only
+static void analyzeExhaustive(Analysis *analysis, WorkerStats *stats, uint64_t begin, uint64_t end) {
+    BoardMask boards[CHUNK_SIZE];
+    uint8_t counts[CHUNK_SIZE];
+    int numBoards = (int)(end - begin);
+
+    BoardMask board = unrankBoard((uint32_t)begin);
+    for (int b = 0; b < numBoards; b++) {
+        boards[b] = board;
+        board = nextBoard(board);
+    }
+    countHapsMaskBatch(boards, counts, numBoards);
+
+    for (int b = 0; b < numBoards; b++) {
+        stats->histogram[counts[b]]++;
+        if (analysis->solveOrder) {
+            TileId boardTiles[NUM_TILES];
+            maskToTiles(boards[b], boardTiles);
+            recordSolveOrder(stats, analysis->variant, boardTiles);
+        }
+    }
+    stats->boards += (uint64_t)numBoards;
+}
+
+// Each block's splitmix64 inputs are distinct from every other block's
+static void startBlock(Analysis *analysis, WorkerStats *stats, uint64_t block) {
+    seedRng(&stats->rng, analysis->seed + block * 4 * 0x9E3779B97F4A7C15ULL);
+    for (int t = 0; t < analysis->variant->numTiles; t++) {
+        stats->deck[t] = (TileId)t;
+    }
+}
+
+static void analyzeSampled(Analysis *analysis, WorkerStats *stats, uint64_t begin, uint64_t end) {
+    const GyulVariant *variant = analysis->variant;
+    TileId boardTiles[MAX_BOARD_SIZE];
+
+    // A stolen range can start mid-block: deal the block's earlier boards
+    // again and drop them
+    uint64_t blockStart = begin - begin % CHUNK_SIZE;
+    startBlock(analysis, stats, blockStart / CHUNK_SIZE);
+    for (uint64_t n = blockStart; n < begin; n++) {
+        dealTiles(stats->deck, variant->numTiles, boardTiles, variant->boardSize, &stats->rng);
+    }
+
+    for (uint64_t n = begin; n < end; n++) {
+        if (n % CHUNK_SIZE == 0 && n != blockStart) {
+            startBlock(analysis, stats, n / CHUNK_SIZE);
+        }
+        dealTiles(stats->deck, variant->numTiles, boardTiles, variant->boardSize, &stats->rng);
+        stats->histogram[variant->countHaps(boardTiles)]++;
+        if (analysis->solveOrder) {
+            recordSolveOrder(stats, variant, boardTiles);
+        }
+    }
+    stats->boards += end - begin;
+}
+
+static void analyzeChunk(void *context, int worker, uint64_t begin, uint64_t end) {
+    Analysis *analysis = context;
+    if (analysis->exhaustive) {
+        analyzeExhaustive(analysis, &analysis->workers[worker], begin, end);
+    } else {
+        analyzeSampled(analysis, &analysis->workers[worker], begin, end);
+    }
+}
+
+static double secondsSince(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-e | -n samples] [-t threads] [-s seed] [-a attributes] [-b board size] [-o]\n"
+            "  -e  every possible board (3 attributes, 9 tiles)\n"
+            "  -n  random boards to sample (default 10000000)\n"
+            "  -t  worker threads (default: all cores)\n"
+            "  -s  64-bit seed, the same sample on any number of threads (default 42)\n"
+            "  -a  number of attributes (default 3)\n"
+            "  -b  tiles on the board (default 9)\n"
+            "  -o  also report solve-order stats\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    unsigned long long numSamples = 10000000;
+    int numThreads = defaultThreadCount();
+    int attributes = 3;
+    int boardSize = NUM_TILES;
+    Analysis analysis = {NULL, false, false, 42, NULL};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-e") == 0) {
+            analysis.exhaustive = true;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            numSamples = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            analysis.seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            attributes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            boardSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            analysis.solveOrder = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    analysis.variant = findVariant(attributes, boardSize);
+    if (analysis.variant == NULL) {
+        fprintf(stderr, "no variant with %d attributes and %d tiles\n", attributes, boardSize);
+        return 1;
+    }
+    if (analysis.exhaustive && (attributes != 3 || boardSize != NUM_TILES)) {
+        fprintf(stderr, "-e needs 3 attributes and %d tiles\n", NUM_TILES);
+        return 1;
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+
+    analysis.workers = calloc((size_t)numThreads, sizeof(WorkerStats));
+    if (analysis.workers == NULL) {
+        perror("workers");
+        return 1;
+    }
+
+    uint64_t total = analysis.exhaustive ? NUM_BOARDS : numSamples;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!parallelFor(total, CHUNK_SIZE, numThreads, analyzeChunk, &analysis)) {
+        perror("parallelFor");
+        return 1;
+    }
+    double elapsed = secondsSince(&start);
+
+    // Merge the per-worker counts
+    uint64_t boards = 0;
+    uint64_t histogram[MAX_VARIANT_HAPS + 1] = {0};
+    uint64_t firstHapDepth[MAX_BOARD_SIZE + 1] = {0};
+    for (int w = 0; w < numThreads; w++) {
+        boards += analysis.workers[w].boards;
+        for (int k = 0; k <= MAX_VARIANT_HAPS; k++) {
+            histogram[k] += analysis.workers[w].histogram[k];
+        }
+        for (int d = 0; d <= MAX_BOARD_SIZE; d++) {
+            firstHapDepth[d] += analysis.workers[w].firstHapDepth[d];
+        }
+    }
+
+    printf("variant: %d attributes, %d tiles  boards: %llu  threads: %d  seconds: %.3f  boards/sec: %.0f\n",
+           attributes, boardSize, (unsigned long long)boards, numThreads, elapsed,
+           elapsed > 0 ? boards / elapsed : 0.0);
+    double weightedHaps = 0;
+    for (int k = 0; k <= MAX_VARIANT_HAPS; k++) {
+        if (histogram[k] > 0) {
+            printf("haps %2d: %12llu  %8.5f%%\n", k, (unsigned long long)histogram[k], 100.0 * histogram[k] / boards);
+            weightedHaps += (double)k * histogram[k];
+        }
+    }
+    printf("mean haps: %.5f\n", boards > 0 ? weightedHaps / boards : 0.0);
+
+    if (analysis.solveOrder) {
+        for (int d = 0; d <= MAX_BOARD_SIZE; d++) {
+            if (firstHapDepth[d] > 0) {
+                printf("first hap within %2d tiles: %12llu\n", d, (unsigned long long)firstHapDepth[d]);
+            }
+        }
+    }
+
+    free(analysis.workers);
+    return 0;
+}
@@ -0,0 +1,335 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_replay.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_pool.h"
+#include "gyulhap_seed.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Audits a replay log without trusting it: every submission is rebuilt
+// from the toggles and re-validated against its board, and every score
+// delta and GYUL is recomputed.
+//
+// Each chunk of rounds goes in three steps: collect every submitted triple,
+// validate them all with validateHapsBatch, then walk the rounds again and
+// score them from the validity bits. A round is flagged for
+//   invalid:   a submission logged as a hap that is not one, or the reverse
+//   score:     a toggle or GYUL whose logged delta is not what the rules give
+//   gyul:      a winning GYUL with haps left, or a losing one with none
+//   superhuman: haps found faster than -m milliseconds each on average, or
+//               all in the same instant
+//   late:      a toggle or GYUL at or after the round's deadline
+//   malformed: a board that isn't nine tiles, a record that fits no round,
+//              a timeout without its deadline, or a timestamp earlier than
+//              the one before it
+
+#define ROUND_GRAIN 256
+#define DEFAULT_MIN_HAP_MS 250
+
+typedef enum { FLAG_INVALID = 1, FLAG_SCORE = 2, FLAG_GYUL = 4, FLAG_SUPERHUMAN = 8, FLAG_LATE = 16, FLAG_MALFORMED = 32 } AuditFlag;
+
+static const char *FLAG_NAMES[] = {"invalid", "score", "gyul", "superhuman", "late", "malformed"};
+#define NUM_FLAGS 6
+
+typedef struct {
+    uint32_t *triples;
+    uint8_t *valid;
+    size_t capacity;
+    uint64_t rounds;
+    uint64_t submissions;
+    uint64_t gyuls;
+    uint64_t flagged[NUM_FLAGS];
+    char padding[64];
+} AuditWorker;
+
+typedef struct {
+    const ReplayReader *reader;
+    const uint64_t *roundStarts;
+    uint8_t *flags; // Per round
+    uint64_t minHapNanos;
+    AuditWorker *workers;
+} Audit;
+
+// Grows the worker's buffers, out of memory ends the audit
+static void reserveTriples(AuditWorker *worker, size_t needed) {
+    if (needed <= worker->capacity) {
+        return;
+    }
+    size_t capacity = worker->capacity ? worker->capacity : 4096;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    uint32_t *triples = realloc(worker->triples, capacity * sizeof(uint32_t));
+    if (triples != NULL) {
+        worker->triples = triples;
+    }
+    uint8_t *valid = realloc(worker->valid, capacity);
+    if (valid != NULL) {
+        worker->valid = valid;
+    }
+    if (triples == NULL || valid == NULL) {
+        perror("audit");
+        exit(1);
+    }
+    worker->capacity = capacity;
+}
+
+// Step 1: the triple of every third toggle, in log order. A round whose
+// board isn't nine tiles is malformed and skipped here and in step 3.
+static size_t collectTriples(const ReplayRecord *records, uint64_t begin, uint64_t end, AuditWorker *worker, size_t count, uint8_t *flags) {
+    TileId boardTiles[NUM_TILES];
+    if (!isBoardMask(records[begin].board)) {
+        *flags |= FLAG_MALFORMED;
+        return count;
+    }
+    seededBoardTiles(records[begin].board, records[begin].value, boardTiles);
+
+    SelectionMask selection = 0;
+    for (uint64_t r = begin + 1; r < end; r++) {
+        if (records[r].type != REPLAY_TOGGLE) {
+            continue;
+        }
+        int position = records[r].position;
+        if (position >= NUM_TILES) {
+            *flags |= FLAG_MALFORMED;
+            continue;
+        }
+        selection ^= (SelectionMask)(1u << position);
+        if (__builtin_popcount(selection) == MAX_SELECTED_TILES) {
+            int a = __builtin_ctz(selection);
+            int b = __builtin_ctz(selection & (selection - 1));
+            int c = 31 - __builtin_clz(selection);
+            reserveTriples(worker, count + 1);
+            worker->triples[count++] = PACK_TRIPLE(boardTiles[a], boardTiles[b], boardTiles[c]);
+            selection = 0;
+        }
+    }
+    return count;
+}
+
+// Step 3: replays the scoring from the validity bits
+static size_t scoreRound(const ReplayRecord *records, uint64_t begin, uint64_t end, AuditWorker *worker, size_t next, uint64_t minHapNanos, uint8_t *flags) {
+    if (!isBoardMask(records[begin].board)) {
+        return next;
+    }
+    int remainingHaps = countHapsMask(records[begin].board);
+    int numHaps = remainingHaps;
+    uint64_t foundLines[2] = {0, 0};
+    SelectionMask selection = 0;
+    uint64_t firstTime = 0, lastHapTime = 0, lastTime = 0, deadline = 0;
+
+    for (uint64_t r = begin + 1; r < end; r++) {
+        const ReplayRecord *record = &records[r];
+        int delta = 0;
+
+        if (record->type == REPLAY_TOGGLE || record->type == REPLAY_GYUL) {
+            if (record->value < lastTime) {
+                *flags |= FLAG_MALFORMED;
+            }
+            if (deadline != 0 && record->value >= deadline) {
+                *flags |= FLAG_LATE;
+            }
+            lastTime = record->value;
+        }
+        if (record->type == REPLAY_DEADLINE) {
+            if (r != begin + 1) {
+                *flags |= FLAG_MALFORMED;
+            }
+            deadline = record->value;
+            continue;
+        }
+        if (record->type == REPLAY_TIMEOUT) {
+            if (deadline == 0 || record->value != deadline) {
+                *flags |= FLAG_MALFORMED;
+            }
+            continue;
+        }
+        if (record->type == REPLAY_TOGGLE && record->position < NUM_TILES) {
+            if (firstTime == 0) {
+                firstTime = record->value;
+            }
+            selection ^= (SelectionMask)(1u << record->position);
+            if (__builtin_popcount(selection) != MAX_SELECTED_TILES) {
+                // Selecting scores nothing, only the third toggle submits
+                if (record->scoreDelta != 0) {
+                    *flags |= FLAG_SCORE;
+                }
+                if (record->result != SUBMIT_NONE) {
+                    *flags |= FLAG_INVALID;
+                }
+                continue;
+            }
+            selection = 0;
+
+            uint32_t triple = worker->triples[next];
+            SubmitResult result = SUBMIT_WRONG;
+            if (worker->valid[next++]) {
+                int line = HAP_LINE_OF[triple & 0xFF][(triple >> 8) & 0xFF];
+                uint64_t bit = 1ULL << (line & 63);
+                result = foundLines[line >> 6] & bit ? SUBMIT_DUPLICATE : SUBMIT_HAP;
+                foundLines[line >> 6] |= bit;
+            }
+            if (result == SUBMIT_HAP) {
+                remainingHaps--;
+                lastHapTime = record->value;
+                delta = 1;
+            } else {
+                delta = -1;
+            }
+            worker->submissions++;
+            if ((record->result == SUBMIT_WRONG) != (result == SUBMIT_WRONG)) {
+                *flags |= FLAG_INVALID;
+            }
+        } else if (record->type == REPLAY_GYUL) {
+            bool wins = remainingHaps == 0;
+            delta = wins ? 3 : -1;
+            worker->gyuls++;
+            if ((record->result != 0) != wins) {
+                *flags |= FLAG_GYUL;
+            }
+        } else {
+            *flags |= FLAG_MALFORMED;
+            continue;
+        }
+
+        if (record->scoreDelta != delta) {
+            *flags |= FLAG_SCORE;
+        }
+    }
+
+    int found = numHaps - remainingHaps;
+    if (found > 0 && (lastHapTime <= firstTime || (lastHapTime - firstTime) / found < minHapNanos)) {
+        *flags |= FLAG_SUPERHUMAN;
+    }
+    return next;
+}
+
+static void auditChunk(void *context, int worker, uint64_t begin, uint64_t end) {
+    Audit *audit = context;
+    AuditWorker *stats = &audit->workers[worker];
+    const ReplayRecord *records = audit->reader->records;
+    const uint64_t *starts = audit->roundStarts;
+
+    size_t count = 0;
+    for (uint64_t round = begin; round < end; round++) {
+        count = collectTriples(records, starts[round], starts[round + 1], stats, count, &audit->flags[round]);
+    }
+    validateHapsBatch(stats->triples, stats->valid, (int)count);
+
+    // Both passes skip the same malformed records, so they stay aligned
+    size_t next = 0;
+    for (uint64_t round = begin; round < end; round++) {
+        next = scoreRound(records, starts[round], starts[round + 1], stats, next, audit->minHapNanos, &audit->flags[round]);
+        for (int f = 0; f < NUM_FLAGS; f++) {
+            stats->flagged[f] += (audit->flags[round] >> f) & 1;
+        }
+        stats->rounds++;
+    }
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-i file] [-t threads] [-m ms] [-v]\n"
+            "  -i  replay log (default " REPLAY_PATH ")\n"
+            "  -t  worker threads (default: all cores)\n"
+            "  -m  fastest believable mean time per hap (default %d)\n"
+            "  -v  list every flagged round\n",
+            program, DEFAULT_MIN_HAP_MS);
+}
+
+int main(int argc, char **argv) {
+    const char *path = REPLAY_PATH;
+    int numThreads = defaultThreadCount();
+    double minHapMs = DEFAULT_MIN_HAP_MS;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            minHapMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+
+    ReplayReader reader;
+    if (!openReplay(&reader, path)) {
+        fprintf(stderr, "%s: not a replay log\n", path);
+        return 1;
+    }
+
+    uint64_t start = monotonicNanos();
+    uint64_t numRounds;
+    uint64_t *roundStarts = indexReplayRounds(&reader, &numRounds);
+    uint8_t *flags = calloc(numRounds + 1, 1);
+    AuditWorker *workers = calloc((size_t)numThreads, sizeof(AuditWorker));
+    if (roundStarts == NULL || flags == NULL || workers == NULL) {
+        perror("audit");
+        return 1;
+    }
+
+    Audit audit = {&reader, roundStarts, flags, (uint64_t)(minHapMs * 1e6), workers};
+    if (!parallelFor(numRounds, ROUND_GRAIN, numThreads, auditChunk, &audit)) {
+        perror("parallelFor");
+        return 1;
+    }
+    double elapsed = (monotonicNanos() - start) / 1e9;
+
+    AuditWorker total;
+    memset(&total, 0, sizeof(total));
+    for (int w = 0; w < numThreads; w++) {
+        total.rounds += workers[w].rounds;
+        total.submissions += workers[w].submissions;
+        total.gyuls += workers[w].gyuls;
+        for (int f = 0; f < NUM_FLAGS; f++) {
+            total.flagged[f] += workers[w].flagged[f];
+        }
+        free(workers[w].triples);
+        free(workers[w].valid);
+    }
+
+    if (verbose) {
+        for (uint64_t round = 0; round < numRounds; round++) {
+            if (flags[round] == 0) {
+                continue;
+            }
+            const ReplayRecord *record = &reader.records[roundStarts[round]];
+            printf("record %llu game %llu:", (unsigned long long)roundStarts[round], (unsigned long long)record->value);
+            for (int f = 0; f < NUM_FLAGS; f++) {
+                if ((flags[round] >> f) & 1) {
+                    printf(" %s", FLAG_NAMES[f]);
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    uint64_t flaggedRounds = 0;
+    for (uint64_t round = 0; round < numRounds; round++) {
+        flaggedRounds += flags[round] != 0;
+    }
+    fprintf(stderr, "rounds: %llu  submissions: %llu  gyuls: %llu  flagged rounds: %llu\n",
+            (unsigned long long)total.rounds, (unsigned long long)total.submissions,
+            (unsigned long long)total.gyuls, (unsigned long long)flaggedRounds);
+    for (int f = 0; f < NUM_FLAGS; f++) {
+        fprintf(stderr, "  %-10s %llu\n", FLAG_NAMES[f], (unsigned long long)total.flagged[f]);
+    }
+    fprintf(stderr, "threads: %d  seconds: %.3f  submissions/sec: %.0f\n", numThreads, elapsed,
+            elapsed > 0 ? total.submissions / elapsed : 0.0);
+
+    free(roundStarts);
+    free(flags);
+    free(workers);
+    closeReplay(&reader);
+    return flaggedRounds == 0 ? 0 : 2;
+}
@@ -0,0 +1,244 @@
+#include "gyulhap_core.h"
+#include "gyulhap_canon.h"
+#include "gyulhap_engine.h"
+#include "gyulhap_rng.h"
+#include "gyulhap_seed.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+// Headless board generator / solver, writes one record per board
+//
+//   text:   tile codes, hap count, then each hap as code/code/code
+//   binary: tile bytes (bg * 9 + shape * 3 + color), 1 hap count byte
+//   none:   only the summary on stderr
+//
+// -a / -b pick another variant from gyulhap_engine.h, whose tiles are
+// written as base-3 digits. With -u a board is only written the first time
+// its canonical form shows up, so a pack never holds the same puzzle twice.
+// -g writes the boards of game numbers first, first + 1, ... exactly as the
+// game deals them, instead of drawing from the seeded generator.
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define BLOCK_SIZE 4096 // Boards scored together by countHapsMaskBatch
+
+typedef enum { FORMAT_TEXT, FORMAT_BINARY, FORMAT_NONE } OutputFormat;
+
+static const char BG_CODES[] = "WGK";
+static const char SHAPE_CODES[] = "CST";
+static const char COLOR_CODES[] = "RYB";
+
+static char *writeTileCode(char *out, const GyulVariant *variant, TileId id) {
+    if (variant->attributes == 3) {
+        *out++ = BG_CODES[id / 9];
+        *out++ = SHAPE_CODES[(id / 3) % 3];
+        *out++ = COLOR_CODES[id % 3];
+        return out;
+    }
+    for (int place = variant->numTiles / 3; place > 0; place /= 3) {
+        *out++ = (char)('0' + (id / place) % 3);
+    }
+    return out;
+}
+
+static void writeText(FILE *out, const GyulVariant *variant, const TileId *boardTiles, uint8_t (*hapPositions)[3], int numHaps) {
+    char line[MAX_BOARD_SIZE * (MAX_ATTRIBUTES + 1) + 4 + MAX_VARIANT_HAPS * (3 * MAX_ATTRIBUTES + 3) + 2];
+    char *p = line;
+
+    for (int i = 0; i < variant->boardSize; i++) {
+        p = writeTileCode(p, variant, boardTiles[i]);
+        *p++ = ' ';
+    }
+    p += sprintf(p, "%d", numHaps);
+    for (int i = 0; i < numHaps; i++) {
+        *p++ = ' ';
+        p = writeTileCode(p, variant, boardTiles[hapPositions[i][0]]);
+        *p++ = '/';
+        p = writeTileCode(p, variant, boardTiles[hapPositions[i][1]]);
+        *p++ = '/';
+        p = writeTileCode(p, variant, boardTiles[hapPositions[i][2]]);
+    }
+    *p++ = '\n';
+    fwrite(line, 1, (size_t)(p - line), out);
+}
+
+static void writeBinary(FILE *out, const GyulVariant *variant, const TileId *boardTiles, int numHaps) {
+    unsigned char record[MAX_BOARD_SIZE + 1];
+    for (int i = 0; i < variant->boardSize; i++) {
+        record[i] = boardTiles[i];
+    }
+    record[variant->boardSize] = (unsigned char)numHaps;
+    fwrite(record, 1, (size_t)variant->boardSize + 1, out);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-n boards] [-s seed] [-f text|binary|none] [-o file] [-u] [-g first game] [-a attributes] [-b board size]\n"
+            "  -n  number of boards to generate (default 1000000)\n"
+            "  -s  64-bit seed (default 42)\n"
+            "  -f  output format (default text)\n"
+            "  -o  output file (default stdout)\n"
+            "  -u  skip boards equivalent to one already written (3 attributes, 9 tiles)\n"
+            "  -g  boards of consecutive game numbers from this one (3 attributes, 9 tiles)\n"
+            "  -a  number of attributes (default 3)\n"
+            "  -b  tiles on the board (default 9)\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    unsigned long long numBoards = 1000000;
+    uint64_t seed = 42;
+    OutputFormat format = FORMAT_TEXT;
+    const char *outPath = NULL;
+    bool uniqueOnly = false;
+    bool byGame = false;
+    uint64_t firstGame = 0;
+    int attributes = 3;
+    int boardSize = NUM_TILES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            numBoards = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "text") == 0) {
+                format = FORMAT_TEXT;
+            } else if (strcmp(name, "binary") == 0) {
+                format = FORMAT_BINARY;
+            } else if (strcmp(name, "none") == 0) {
+                format = FORMAT_NONE;
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "-u") == 0) {
+            uniqueOnly = true;
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            byGame = true;
+            firstGame = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            attributes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            boardSize = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const GyulVariant *variant = findVariant(attributes, boardSize);
+    if (variant == NULL) {
+        fprintf(stderr, "no variant with %d attributes and %d tiles, available:", attributes, boardSize);
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            fprintf(stderr, " %d/%d", GYUL_VARIANT_TABLE[v].attributes, GYUL_VARIANT_TABLE[v].boardSize);
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    // The 27-bit mask paths only cover the classic game
+    bool isClassic = attributes == 3 && boardSize == NUM_TILES;
+    if (uniqueOnly && !isClassic) {
+        fprintf(stderr, "-u needs 3 attributes and %d tiles\n", NUM_TILES);
+        return 1;
+    }
+    if (byGame && !isClassic) {
+        fprintf(stderr, "-g needs 3 attributes and %d tiles\n", NUM_TILES);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (outPath != NULL) {
+        out = fopen(outPath, format == FORMAT_BINARY ? "wb" : "w");
+        if (out == NULL) {
+            perror(outPath);
+            return 1;
+        }
+    }
+    static char outBuffer[OUTPUT_BUFFER_SIZE];
+    setvbuf(out, outBuffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    TileId deck[MAX_VARIANT_TILES];
+    for (int t = 0; t < variant->numTiles; t++) {
+        deck[t] = (TileId)t;
+    }
+
+    static TileId blockTiles[BLOCK_SIZE][MAX_BOARD_SIZE];
+    static BoardMask blockMasks[BLOCK_SIZE];
+    static uint8_t blockCounts[BLOCK_SIZE];
+    uint8_t hapPositions[MAX_VARIANT_HAPS][3];
+    unsigned long long histogram[MAX_VARIANT_HAPS + 1] = {0};
+    GyulRng rng;
+    seedRng(&rng, seed);
+    unsigned long long numWritten = 0;
+
+    SolutionCache cache;
+    if (uniqueOnly && !initSolutionCache(&cache, 1 << 16)) {
+        perror("solution cache");
+        return 1;
+    }
+
+    clock_t start = clock();
+    for (unsigned long long n = 0; n < numBoards; n += BLOCK_SIZE) {
+        int blockBoards = numBoards - n < BLOCK_SIZE ? (int)(numBoards - n) : BLOCK_SIZE;
+
+        for (int b = 0; b < blockBoards; b++) {
+            if (byGame) {
+                uint64_t game = firstGame + n + (uint64_t)b;
+                seededBoardTiles(boardFromSeed(game), game, blockTiles[b]);
+            } else {
+                dealTiles(deck, variant->numTiles, blockTiles[b], boardSize, &rng);
+            }
+        }
+        if (isClassic) {
+            for (int b = 0; b < blockBoards; b++) {
+                blockMasks[b] = boardToMask(blockTiles[b], NUM_TILES);
+            }
+            countHapsMaskBatch(blockMasks, blockCounts, blockBoards);
+        } else {
+            for (int b = 0; b < blockBoards; b++) {
+                blockCounts[b] = (uint8_t)variant->countHaps(blockTiles[b]);
+            }
+        }
+
+        for (int b = 0; b < blockBoards; b++) {
+            int numHaps = blockCounts[b];
+            histogram[numHaps]++;
+
+            if (uniqueOnly && solveCached(&cache, blockMasks[b], NULL)->timesSeen > 1) {
+                continue;
+            }
+            numWritten++;
+
+            if (format == FORMAT_TEXT) {
+                variant->findHaps(blockTiles[b], hapPositions);
+                writeText(out, variant, blockTiles[b], hapPositions, numHaps);
+            } else if (format == FORMAT_BINARY) {
+                writeBinary(out, variant, blockTiles[b], numHaps);
+            }
+        }
+    }
+    fflush(out);
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    fprintf(stderr, "boards: %llu  written: %llu  seconds: %.3f  boards/sec: %.0f\n",
+            numBoards, numWritten, elapsed, elapsed > 0 ? numBoards / elapsed : 0.0);
+    for (int k = 0; k <= MAX_VARIANT_HAPS; k++) {
+        if (histogram[k] > 0) {
+            fprintf(stderr, "haps %2d: %llu\n", k, histogram[k]);
+        }
+    }
+
+    if (uniqueOnly) {
+        freeSolutionCache(&cache);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
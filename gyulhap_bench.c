@@ -0,0 +1,580 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_core.h"
+#include "gyulhap_canon.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_render.h"
+#include "gyulhap_rng.h"
+#include "gyulhap_seed.h"
+#include "gyulhap_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Benchmarks for the rules, the batch kernels and a scripted headless round
+// (deal, every hap found, a frame drawn through the recording renderer after
+// each toggle, GYUL), played directly and through the simulation core. Each
+// benchmark doubles its iteration count until a run takes -d seconds, then
+// reports ns/op, ops/sec and heap allocations per op as JSON, one object per
+// benchmark.
+//
+// Allocations are counted by wrapping malloc, calloc and realloc at link
+// time (GNU ld --wrap, see the makefile), so only calls from this binary and
+// libgyulhap are seen. Without it allocs_per_op is null.
+//
+// -c runs no benchmark, only checkFrames, and exits 2 on a mismatch.
+
+#define NUM_INPUTS 4096 // Power of two, inputs are cycled
+#define DEFAULT_SECONDS 0.2
+
+#ifdef GYUL_COUNT_ALLOCS
+static uint64_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+#endif
+
+typedef uint64_t (*BenchFn)(uint64_t iterations);
+
+typedef struct {
+    const char *name;
+    const char *unit; // What one op is
+    BenchFn run;
+} Benchmark;
+
+// Shared inputs, one board (or triple) per slot
+static Tile boards[NUM_INPUTS][NUM_TILES];
+static TileId boardIds[NUM_INPUTS][NUM_TILES];
+static BoardMask boardMasks[NUM_INPUTS];
+static Tile triples[NUM_INPUTS][3];
+static uint32_t packedTriples[NUM_INPUTS];
+static Tile deck[TOTAL_COMBINATIONS];
+static uint64_t sink; // Keeps results alive
+
+static void makeInputs(uint64_t seed) {
+    GyulRng rng;
+    TileId ids[TOTAL_COMBINATIONS];
+    seedRng(&rng, seed);
+    for (int t = 0; t < TOTAL_COMBINATIONS; t++) {
+        ids[t] = (TileId)t;
+        deck[t] = tileFromId((TileId)t);
+    }
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        dealTiles(ids, TOTAL_COMBINATIONS, boardIds[i], NUM_TILES, &rng);
+        for (int t = 0; t < NUM_TILES; t++) {
+            boards[i][t] = tileFromId(boardIds[i][t]);
+        }
+        boardMasks[i] = boardToMask(boardIds[i], NUM_TILES);
+
+        // Half the triples are haps
+        TileId a = (TileId)rngBelow(&rng, TOTAL_COMBINATIONS);
+        TileId b = (TileId)rngBelow(&rng, TOTAL_COMBINATIONS);
+        TileId c = i % 2 ? THIRD_TILE[a][b] : (TileId)rngBelow(&rng, TOTAL_COMBINATIONS);
+        triples[i][0] = tileFromId(a);
+        triples[i][1] = tileFromId(b);
+        triples[i][2] = tileFromId(c);
+        packedTriples[i] = PACK_TRIPLE(a, b, c);
+    }
+}
+
+static uint64_t benchIsValidHap(uint64_t iterations) {
+    uint64_t valid = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        Tile *triple = triples[n & (NUM_INPUTS - 1)];
+        valid += isValidHap(triple[0], triple[1], triple[2]);
+    }
+    return valid;
+}
+
+static uint64_t benchIsValidHapPacked(uint64_t iterations) {
+    uint64_t valid = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        uint32_t triple = packedTriples[n & (NUM_INPUTS - 1)];
+        valid += isValidHapPacked(triple & 0xFF, (triple >> 8) & 0xFF, triple >> 16);
+    }
+    return valid;
+}
+
+static uint64_t benchValidateHapsBatch(uint64_t iterations) {
+    static uint8_t valid[NUM_INPUTS];
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n += NUM_INPUTS) {
+        int count = iterations - n < NUM_INPUTS ? (int)(iterations - n) : NUM_INPUTS;
+        validateHapsBatch(packedTriples, valid, count);
+        total += valid[0];
+    }
+    return total;
+}
+
+static uint64_t benchCompareTiles(uint64_t iterations) {
+    uint64_t same = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        same += compareTiles(triples[n & (NUM_INPUTS - 1)], triples[(n + 1) & (NUM_INPUTS - 1)]);
+    }
+    return same;
+}
+
+static uint64_t benchCountAllHaps(uint64_t iterations) {
+    uint64_t haps = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        haps += countAllHaps(boards[n & (NUM_INPUTS - 1)], NUM_TILES);
+    }
+    return haps;
+}
+
+static uint64_t benchCountHapsMask(uint64_t iterations) {
+    uint64_t haps = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        haps += countHapsMask(boardMasks[n & (NUM_INPUTS - 1)]);
+    }
+    return haps;
+}
+
+static uint64_t benchCountHapsMaskBatch(uint64_t iterations) {
+    static uint8_t counts[NUM_INPUTS];
+    uint64_t haps = 0;
+    for (uint64_t n = 0; n < iterations; n += NUM_INPUTS) {
+        int count = iterations - n < NUM_INPUTS ? (int)(iterations - n) : NUM_INPUTS;
+        countHapsMaskBatch(boardMasks, counts, count);
+        haps += counts[0];
+    }
+    return haps;
+}
+
+static uint64_t benchFindAllHaps(uint64_t iterations) {
+    Tile haps[MAX_HAPS][3];
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        findAllHaps(boards[n & (NUM_INPUTS - 1)], NUM_TILES, haps);
+        total += haps[0][0].shape;
+    }
+    return total;
+}
+
+static uint64_t benchFindHapsPacked(uint64_t iterations) {
+    uint8_t hapPositions[MAX_HAPS][3];
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        total += findHapsPacked(boardIds[n & (NUM_INPUTS - 1)], NUM_TILES, hapPositions);
+    }
+    return total;
+}
+
+static uint64_t benchShuffleArray(uint64_t iterations) {
+    for (uint64_t n = 0; n < iterations; n++) {
+        shuffleArray(deck, TOTAL_COMBINATIONS);
+    }
+    return deck[0].shape;
+}
+
+static uint64_t benchDealTiles(uint64_t iterations) {
+    TileId ids[TOTAL_COMBINATIONS];
+    TileId board[NUM_TILES];
+    GyulRng rng;
+    seedRng(&rng, 1);
+    for (int t = 0; t < TOTAL_COMBINATIONS; t++) {
+        ids[t] = (TileId)t;
+    }
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        dealTiles(ids, TOTAL_COMBINATIONS, board, NUM_TILES, &rng);
+        total += board[0];
+    }
+    return total;
+}
+
+static uint64_t benchBoardFromSeed(uint64_t iterations) {
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        total += boardFromSeed(n);
+    }
+    return total;
+}
+
+static uint64_t benchCanonicalBoard(uint64_t iterations) {
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        total += canonicalBoard(boardMasks[n & (NUM_INPUTS - 1)], NULL);
+    }
+    return total;
+}
+
+// One submission: three toggles on a fresh round, alternating hap and miss
+static uint64_t benchSubmission(uint64_t iterations) {
+    uint8_t hapPositions[MAX_HAPS][3];
+    GameState game;
+    uint64_t total = 0;
+    for (uint64_t n = 0; n < iterations; n++) {
+        const TileId *tiles = boardIds[n & (NUM_INPUTS - 1)];
+        startRound(&game, tiles);
+        if ((n & 1) && findHapsPacked(tiles, NUM_TILES, hapPositions) > 0) {
+            togglePosition(&game, hapPositions[0][0]);
+            togglePosition(&game, hapPositions[0][1]);
+            total += togglePosition(&game, hapPositions[0][2]);
+        } else {
+            togglePosition(&game, 0);
+            togglePosition(&game, 4);
+            total += togglePosition(&game, 8);
+        }
+    }
+    return total;
+}
+
+// One tile swapped for one that is not on the board, Canon style
+static uint64_t benchReplaceTile(uint64_t iterations) {
+    GameState game;
+    uint64_t total = 0;
+    startRound(&game, boardIds[0]);
+    for (uint64_t n = 0; n < iterations; n++) {
+        TileId tile = boardIds[n & (NUM_INPUTS - 1)][0];
+        if (!replaceTile(&game, (int)(n % NUM_TILES), tile)) {
+            // The lowest tile off the board, so every iteration swaps one
+            tile = (TileId)__builtin_ctz(~game.board & ((1u << TOTAL_COMBINATIONS) - 1));
+            replaceTile(&game, (int)(n % NUM_TILES), tile);
+        }
+        total += (uint64_t)game.remainingHaps;
+    }
+    return total;
+}
+
+// The game screen through the recording renderer, as the GUI draws it
+static Renderer renderer;
+static RenderRecording recording;
+static GameScene scene;
+static SolutionCache cache; // The session's played-board cache
+
+static void drawFrame(GameHud *hud, const GameState *game) {
+    updateGameHud(hud, game);
+    beginRecordedFrame(&recording);
+    renderer.clear(renderer.context, (RenderColor){211, 176, 131, 255});
+    drawGameScene(&renderer, &scene, hud, game);
+}
+
+static uint64_t benchFrame(uint64_t iterations) {
+    GameState game;
+    GameHud hud;
+    startRound(&game, boardIds[0]);
+    startGameHud(&hud, &scene, &renderer, &game, 0, -1);
+    for (uint64_t n = 0; n < iterations; n++) {
+        game.selection = (SelectionMask)(n & 0x1FF);
+        drawFrame(&hud, &game);
+    }
+    return recording.checksum;
+}
+
+// Deal by game number with the session's played-board cache, find every
+// hap through the toggles with a frame after each, then GYUL
+static uint64_t benchRound(uint64_t iterations) {
+    static uint64_t nextGame;
+    uint8_t hapPositions[MAX_HAPS][3];
+    TileId tiles[NUM_TILES];
+    GameState game;
+    GameHud hud;
+    uint64_t total = 0;
+
+    for (uint64_t n = 0; n < iterations; n++) {
+        uint64_t gameNumber = nextGame++;
+        BoardMask board = boardFromSeed(gameNumber);
+        int symmetry;
+        const CachedSolution *solution = solveCached(&cache, board, &symmetry);
+        seededBoardTiles(board, gameNumber, tiles);
+        startRound(&game, tiles);
+        startGameHud(&hud, &scene, &renderer, &game, gameNumber, -1);
+        drawFrame(&hud, &game);
+
+        int numHaps = findHapsPacked(tiles, NUM_TILES, hapPositions);
+        for (int h = 0; h < numHaps; h++) {
+            for (int t = 0; t < 3; t++) {
+                togglePosition(&game, hapPositions[h][t]);
+                drawFrame(&hud, &game);
+            }
+        }
+        claimGyul(&game);
+        drawFrame(&hud, &game);
+        total += (uint64_t)game.score + solution->timesSeen;
+    }
+    return total;
+}
+
+// The same round as the GUI plays it: presses pushed as commands, one
+// simulation step per press on a clock of its own, each frame drawn from
+// the snapshot the step published
+static uint64_t benchSimRound(uint64_t iterations) {
+    static Simulation sim;
+    static uint64_t nextGame;
+    static uint64_t now;
+    uint8_t hapPositions[MAX_HAPS][3];
+    SimCommand command;
+    GameHud hud;
+    uint64_t total = 0;
+
+    if (now == 0) {
+        initSimulation(&sim, NULL, NULL, 0);
+    }
+    for (uint64_t n = 0; n < iterations; n++) {
+        memset(&command, 0, sizeof(command));
+        command.type = SIM_START;
+        command.time = now;
+        command.timeLimitNanos = 60000000000ULL;
+        command.gameNumber = nextGame++;
+        seededBoardTiles(boardFromSeed(command.gameNumber), command.gameNumber, command.tiles);
+        pushSimCommand(&sim, &command);
+        stepSimulation(&sim, now += SIM_TICK_NANOS);
+        const SimSnapshot *snapshot = latestSnapshot(&sim);
+        startGameHud(&hud, &scene, &renderer, &snapshot->game, snapshot->gameNumber, -1);
+        drawFrame(&hud, &snapshot->game);
+
+        int numHaps = findHapsPacked(snapshot->game.tiles, NUM_TILES, hapPositions);
+        command.type = SIM_TOGGLE;
+        for (int h = 0; h < numHaps; h++) {
+            for (int t = 0; t < 3; t++) {
+                command.position = hapPositions[h][t];
+                command.time = now;
+                pushSimCommand(&sim, &command);
+                stepSimulation(&sim, now += SIM_TICK_NANOS);
+                snapshot = latestSnapshot(&sim);
+                drawFrame(&hud, &snapshot->game);
+            }
+        }
+        command.type = SIM_GYUL;
+        command.time = now;
+        pushSimCommand(&sim, &command);
+        stepSimulation(&sim, now += SIM_TICK_NANOS);
+        snapshot = latestSnapshot(&sim);
+        drawFrame(&hud, &snapshot->game);
+        total += (uint64_t)snapshot->game.score + snapshot->tally.haps;
+    }
+    return total;
+}
+
+static const Benchmark BENCHMARKS[] = {
+    {"isValidHap", "triple", benchIsValidHap},
+    {"isValidHapPacked", "triple", benchIsValidHapPacked},
+    {"validateHapsBatch", "triple", benchValidateHapsBatch},
+    {"compareTiles", "triple", benchCompareTiles},
+    {"countAllHaps", "board", benchCountAllHaps},
+    {"countHapsMask", "board", benchCountHapsMask},
+    {"countHapsMaskBatch", "board", benchCountHapsMaskBatch},
+    {"findAllHaps", "board", benchFindAllHaps},
+    {"findHapsPacked", "board", benchFindHapsPacked},
+    {"shuffleArray", "deck", benchShuffleArray},
+    {"dealTiles", "board", benchDealTiles},
+    {"boardFromSeed", "board", benchBoardFromSeed},
+    {"canonicalBoard", "board", benchCanonicalBoard},
+    {"submission", "submission", benchSubmission},
+    {"replaceTile", "swap", benchReplaceTile},
+    {"frame", "frame", benchFrame},
+    {"round", "round", benchRound},
+    {"simRound", "round", benchSimRound},
+};
+#define NUM_BENCHMARKS (int)(sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]))
+
+// Regression check of the headless frames: game CHECK_GAME played as in
+// benchRound and again through the simulation as in benchSimRound, both
+// drawn through the recording renderer. Both must give the expected draw
+// command count and checksum of their frames; a change to the rules, the
+// layout or the draw calls that is meant to change them updates these.
+#define CHECK_GAME 42
+#define CHECK_FRAMES 14 // The deal, 4 haps of 3 toggles, the GYUL
+#define CHECK_COMMANDS 210
+#define CHECK_CHECKSUM 0x9bee2a415bd33ddcULL
+
+typedef struct {
+    uint64_t frames;
+    uint64_t commands;
+    uint64_t checksum; // FNV-1a over the frames' own checksums
+} FrameTrace;
+
+static uint64_t countCommands(void) {
+    uint64_t commands = 0;
+    for (int op = 0; op < RENDER_OP_COUNT; op++) {
+        commands += recording.ops[op];
+    }
+    return commands;
+}
+
+static void traceFrame(FrameTrace *trace, GameHud *hud, const GameState *game) {
+    uint64_t before = countCommands();
+    drawFrame(hud, game);
+    trace->frames++;
+    trace->commands += countCommands() - before;
+    trace->checksum = (trace->checksum ^ recording.checksum) * 1099511628211ULL;
+}
+
+static FrameTrace traceRound(bool throughSim) {
+    static Simulation sim;
+    uint8_t hapPositions[MAX_HAPS][3];
+    TileId tiles[NUM_TILES];
+    FrameTrace trace = {0, 0, 14695981039346656037ULL};
+    SimCommand command;
+    GameState game;
+    GameHud hud;
+    const GameState *shown = &game;
+    uint64_t now = SIM_TICK_NANOS;
+
+    seededBoardTiles(boardFromSeed(CHECK_GAME), CHECK_GAME, tiles);
+    int numHaps = findHapsPacked(tiles, NUM_TILES, hapPositions);
+    memset(&command, 0, sizeof(command));
+    if (throughSim) {
+        initSimulation(&sim, NULL, NULL, 0);
+        command.type = SIM_START;
+        command.gameNumber = CHECK_GAME;
+        memcpy(command.tiles, tiles, sizeof(tiles));
+        pushSimCommand(&sim, &command);
+        stepSimulation(&sim, now += SIM_TICK_NANOS);
+        shown = &latestSnapshot(&sim)->game;
+    } else {
+        startRound(&game, tiles);
+    }
+    startGameHud(&hud, &scene, &renderer, shown, CHECK_GAME, -1);
+    traceFrame(&trace, &hud, shown);
+
+    for (int press = 0; press <= numHaps * 3; press++) {
+        command.type = press < numHaps * 3 ? SIM_TOGGLE : SIM_GYUL;
+        command.position = press < numHaps * 3 ? hapPositions[press / 3][press % 3] : 0;
+        if (throughSim) {
+            command.time = now;
+            pushSimCommand(&sim, &command);
+            stepSimulation(&sim, now += SIM_TICK_NANOS);
+            shown = &latestSnapshot(&sim)->game;
+        } else if (command.type == SIM_TOGGLE) {
+            togglePosition(&game, command.position);
+        } else {
+            claimGyul(&game);
+        }
+        traceFrame(&trace, &hud, shown);
+    }
+    return trace;
+}
+
+static bool checkFrames(void) {
+    bool ok = true;
+    for (int throughSim = 0; throughSim < 2; throughSim++) {
+        FrameTrace trace = traceRound(throughSim);
+        bool matches = trace.frames == CHECK_FRAMES && trace.commands == CHECK_COMMANDS && trace.checksum == CHECK_CHECKSUM;
+        fprintf(stderr, "%-10s frames: %llu  commands: %llu  checksum: 0x%016llx  %s\n", throughSim ? "simRound" : "round",
+                (unsigned long long)trace.frames, (unsigned long long)trace.commands, (unsigned long long)trace.checksum,
+                matches ? "ok" : "MISMATCH");
+        ok = ok && matches;
+    }
+    return ok;
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-c] [-d seconds] [-f filter] [-o file]\n"
+            "  -c  only check the headless frames against their expected checksums\n"
+            "  -d  minimum time per benchmark (default %.1f)\n"
+            "  -f  only benchmarks whose name contains this\n"
+            "  -o  JSON output file (default stdout)\n",
+            program, DEFAULT_SECONDS);
+}
+
+int main(int argc, char **argv) {
+    double minSeconds = DEFAULT_SECONDS;
+    const char *filter = NULL;
+    const char *outPath = NULL;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            minSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!initSolutionCache(&cache, 1 << 12)) {
+        perror("cache");
+        return 1;
+    }
+    makeInputs(42);
+    srand(42);
+    initRecordingRenderer(&renderer, &recording);
+    initGameScene(&scene, &renderer, 800, (GridLayout){125, 100, 150, 50, 3, 3}, (RenderRect){300, 700, 200, 50});
+    if (check) {
+        freeSolutionCache(&cache);
+        return checkFrames() ? 0 : 2;
+    }
+
+    FILE *out = stdout;
+    if (outPath != NULL) {
+        out = fopen(outPath, "w");
+        if (out == NULL) {
+            perror(outPath);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\"benchmarks\": [");
+    bool first = true;
+    for (int b = 0; b < NUM_BENCHMARKS; b++) {
+        const Benchmark *bench = &BENCHMARKS[b];
+        if (filter != NULL && strstr(bench->name, filter) == NULL) {
+            continue;
+        }
+
+        // Warm up, then double until a run is long enough
+        sink += bench->run(1000);
+        uint64_t iterations = 1000;
+        uint64_t elapsed = 0;
+        uint64_t allocs = 0;
+        for (;;) {
+#ifdef GYUL_COUNT_ALLOCS
+            uint64_t allocsBefore = allocations;
+#endif
+            uint64_t start = monotonicNanos();
+            sink += bench->run(iterations);
+            elapsed = monotonicNanos() - start;
+#ifdef GYUL_COUNT_ALLOCS
+            allocs = allocations - allocsBefore;
+#endif
+            if (elapsed >= minSeconds * 1e9 || iterations >= (1ULL << 40)) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double nsPerOp = (double)elapsed / iterations;
+        fprintf(out, "%s\n  {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"per_sec\": %.0f, \"allocs_per_op\": ",
+                first ? "" : ",", bench->name, bench->unit, (unsigned long long)iterations, nsPerOp, 1e9 / nsPerOp);
+#ifdef GYUL_COUNT_ALLOCS
+        fprintf(out, "%.6f}", (double)allocs / iterations);
+#else
+        (void)allocs;
+        fprintf(out, "null}");
+#endif
+        fprintf(stderr, "%-20s %12.2f ns/%-10s %14.0f %s/sec\n", bench->name, nsPerOp, bench->unit, 1e9 / nsPerOp, bench->unit);
+        first = false;
+    }
+    fprintf(out, "\n], \"checksum\": %llu}\n", (unsigned long long)sink);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    freeSolutionCache(&cache);
+    return 0;
+}
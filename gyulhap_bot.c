@@ -0,0 +1,625 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_net.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_rng.h"
+#include "gyulhap_seed.h"
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Bot players for gyulhap-server, any number of them from one epoll loop.
+//
+// A bot solves each board as it is dealt and plays it like a person: after
+// a reaction time drawn from a log-normal around -k milliseconds it claims
+// a hap nobody has claimed yet (it follows the room's results), and with
+// -m percent chance it picks a wrong triple or calls GYUL too early
+// instead. Once every hap is taken it calls GYUL. With -k 0 bots act as
+// soon as their last result is back, which makes it a closed-loop load
+// generator: -n 20000 -k 0 is the capacity test.
+//
+// Latency is measured per action, from send to the bot's own result.
+//
+// -w adds that many spectators to every room in play. They follow the
+// room from its snapshots and deltas, check each delta against the board
+// (a won hap must be on it and new, a won GYUL must leave none) and check
+// that a snapshot of the current round agrees with what they applied.
+
+#define DEFAULT_BOTS 4
+#define DEFAULT_PLAYERS_PER_ROOM 4
+#define DEFAULT_SECONDS 10
+#define DEFAULT_REACTION_MS 1500
+#define DEFAULT_MISTAKE_PERCENT 5
+#define REACTION_SIGMA 0.5 // Log-normal shape, median stays at -k
+#define RETRY_NANOS 1000000 // Socket buffer full, try again in 1ms
+#define MAX_EVENTS 256
+#define IN_BUFFER_SIZE (16 * sizeof(NetMessage))
+#define SPECTATOR_BUFFER_SIZE 4096
+
+typedef struct {
+    int fd;
+    int player;
+    uint32_t timerGeneration; // Older heap entries are stale
+    uint64_t sentAt; // 0 when nothing is outstanding
+    uint64_t sentGame; // Round the outstanding action was for
+    uint64_t gameNumber;
+    TileId tiles[NUM_TILES];
+    uint8_t hapPositions[MAX_HAPS][3];
+    int numHaps;
+    uint64_t claimedLines[2]; // Haps anyone in the room has won
+    size_t inBytes;
+    unsigned char in[IN_BUFFER_SIZE];
+} Bot;
+
+typedef struct {
+    int fd;
+    bool synced; // Has had a snapshot
+    uint64_t gameNumber;
+    BoardMask board;
+    uint64_t foundLines[2];
+    int16_t scores[NET_MAX_PLAYERS];
+    int remainingHaps;
+    size_t inBytes;
+    unsigned char in[SPECTATOR_BUFFER_SIZE];
+} Spectator;
+
+typedef struct {
+    uint64_t deadline;
+    uint32_t bot;
+    uint32_t generation;
+} Timer;
+
+// Binary min-heap on deadline
+typedef struct {
+    Timer *timers;
+    size_t size;
+    size_t capacity;
+} TimerHeap;
+
+typedef struct {
+    uint64_t rounds; // Summed over bots
+    uint64_t actions;
+    uint64_t haps;
+    uint64_t duplicates; // Lost a race, or a deliberate repeat
+    uint64_t wrong;
+    uint64_t gyulsWon;
+    uint64_t gyulsWrong;
+    uint64_t errors;
+    uint64_t stale; // Lost a race to the GYUL that ended the round
+    uint64_t disconnects;
+    int64_t score;
+    LatencyHistogram latency; // Send to own result, nanoseconds
+    uint64_t frames; // Spectators, summed
+    uint64_t snapshots;
+    uint64_t spectatorBytes;
+    uint64_t inconsistent; // Deltas or snapshots that disagree with the board
+} BotStats;
+
+typedef struct {
+    Bot *bots;
+    int numBots;
+    Spectator *spectators;
+    int numSpectators;
+    int epoll;
+    double reactionNanos;
+    int mistakePercent;
+    GyulRng rng;
+    TimerHeap heap;
+    BotStats stats;
+} Swarm;
+
+static volatile sig_atomic_t stopRequested;
+
+static void requestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+static bool pushTimer(TimerHeap *heap, Timer timer) {
+    if (heap->size == heap->capacity) {
+        size_t capacity = heap->capacity ? heap->capacity * 2 : 1024;
+        Timer *timers = realloc(heap->timers, capacity * sizeof(Timer));
+        if (timers == NULL) {
+            return false;
+        }
+        heap->timers = timers;
+        heap->capacity = capacity;
+    }
+
+    size_t i = heap->size++;
+    while (i > 0 && heap->timers[(i - 1) / 2].deadline > timer.deadline) {
+        heap->timers[i] = heap->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->timers[i] = timer;
+    return true;
+}
+
+static Timer popTimer(TimerHeap *heap) {
+    Timer top = heap->timers[0];
+    Timer last = heap->timers[--heap->size];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size && heap->timers[child + 1].deadline < heap->timers[child].deadline) {
+            child++;
+        }
+        if (heap->timers[child].deadline >= last.deadline) {
+            break;
+        }
+        heap->timers[i] = heap->timers[child];
+        i = child;
+    }
+    if (heap->size > 0) {
+        heap->timers[i] = last;
+    }
+    return top;
+}
+
+static double uniform(GyulRng *rng) {
+    return ((nextRng(rng) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Log-normal with the given median, Box-Muller for the normal draw
+static uint64_t reactionTime(Swarm *swarm) {
+    if (swarm->reactionNanos <= 0) {
+        return 0;
+    }
+    double normal = sqrt(-2.0 * log(uniform(&swarm->rng))) * cos(6.283185307179586 * uniform(&swarm->rng));
+    return (uint64_t)(swarm->reactionNanos * exp(REACTION_SIGMA * normal));
+}
+
+static void schedule(Swarm *swarm, int index, uint64_t delay) {
+    Bot *bot = &swarm->bots[index];
+    Timer timer = {monotonicNanos() + delay, (uint32_t)index, ++bot->timerGeneration};
+    if (!pushTimer(&swarm->heap, timer)) {
+        perror("timers");
+        exit(1);
+    }
+}
+
+static void disconnectBot(Swarm *swarm, Bot *bot) {
+    if (bot->fd >= 0) {
+        close(bot->fd);
+        bot->fd = -1;
+        bot->timerGeneration++;
+        swarm->stats.disconnects++;
+    }
+}
+
+static bool isClaimed(const Bot *bot, int line) {
+    return (bot->claimedLines[line >> 6] >> (line & 63)) & 1;
+}
+
+// The next unclaimed hap from a random starting point, so bots in one room
+// don't all go for the same one. -1 once every hap is taken.
+static int pickHap(Swarm *swarm, const Bot *bot) {
+    if (bot->numHaps == 0) {
+        return -1;
+    }
+    int start = (int)rngBelow(&swarm->rng, (uint32_t)bot->numHaps);
+    for (int i = 0; i < bot->numHaps; i++) {
+        int h = (start + i) % bot->numHaps;
+        const uint8_t *positions = bot->hapPositions[h];
+        if (!isClaimed(bot, HAP_LINE_OF[bot->tiles[positions[0]]][bot->tiles[positions[1]]])) {
+            return h;
+        }
+    }
+    return -1;
+}
+
+static void act(Swarm *swarm, int index) {
+    Bot *bot = &swarm->bots[index];
+    NetMessage message = {NET_CLAIM, 0, 0, 0, {0, 1, 2}, 0, bot->gameNumber};
+
+    int hap = pickHap(swarm, bot);
+    bool mistake = (int)rngBelow(&swarm->rng, 100) < swarm->mistakePercent;
+    if (mistake && hap >= 0 && rngBelow(&swarm->rng, 4) == 0) {
+        message.type = NET_GYUL; // Too early
+    } else if (mistake || hap < 0) {
+        if (hap < 0) {
+            message.type = NET_GYUL;
+        } else {
+            // Three distinct random positions, almost never a hap
+            uint8_t order[NUM_TILES] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+            for (int i = 0; i < 3; i++) {
+                int j = i + (int)rngBelow(&swarm->rng, NUM_TILES - i);
+                uint8_t swap = order[i];
+                order[i] = order[j];
+                order[j] = swap;
+                message.positions[i] = order[i];
+            }
+        }
+    } else {
+        memcpy(message.positions, bot->hapPositions[hap], 3);
+    }
+
+    ssize_t count = send(bot->fd, &message, sizeof(message), MSG_NOSIGNAL);
+    if (count == (ssize_t)sizeof(message)) {
+        bot->sentAt = monotonicNanos();
+        bot->sentGame = bot->gameNumber;
+        swarm->stats.actions++;
+    } else if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+        schedule(swarm, index, RETRY_NANOS);
+    } else {
+        disconnectBot(swarm, bot); // Including a short write, framing is lost
+    }
+}
+
+static void startBotRound(Swarm *swarm, int index, const NetMessage *round) {
+    Bot *bot = &swarm->bots[index];
+    bot->player = round->player;
+    bot->gameNumber = round->value;
+    seededBoardTiles(boardFromSeed(round->value), round->value, bot->tiles);
+    bot->numHaps = findHapsPacked(bot->tiles, NUM_TILES, bot->hapPositions);
+    bot->claimedLines[0] = 0;
+    bot->claimedLines[1] = 0;
+    swarm->stats.rounds++;
+
+    // An action in flight gets its result first, then the bot moves on
+    if (bot->sentAt == 0) {
+        schedule(swarm, index, reactionTime(swarm));
+    }
+}
+
+static void handleResult(Swarm *swarm, int index, const NetMessage *result) {
+    Bot *bot = &swarm->bots[index];
+    if (result->result == SUBMIT_HAP) {
+        int line = HAP_LINE_OF[bot->tiles[result->positions[0]]][bot->tiles[result->positions[1]]];
+        bot->claimedLines[line >> 6] |= 1ULL << (line & 63);
+    }
+    if (result->player != bot->player || result->value != bot->sentGame || bot->sentAt == 0) {
+        return;
+    }
+
+    recordLatency(&swarm->stats.latency, monotonicNanos() - bot->sentAt);
+    bot->sentAt = 0;
+    swarm->stats.score += result->scoreDelta;
+    switch (result->result) {
+        case SUBMIT_HAP:
+            swarm->stats.haps++;
+            break;
+        case SUBMIT_DUPLICATE:
+            swarm->stats.duplicates++;
+            break;
+        case SUBMIT_WRONG:
+            swarm->stats.wrong++;
+            break;
+        case NET_GYUL_WON:
+            swarm->stats.gyulsWon++;
+            return; // The next round's NET_ROUND schedules the bot
+        case NET_GYUL_WRONG:
+            swarm->stats.gyulsWrong++;
+            break;
+    }
+    schedule(swarm, index, reactionTime(swarm));
+}
+
+static void handleMessage(Swarm *swarm, int index, const NetMessage *message) {
+    Bot *bot = &swarm->bots[index];
+    switch (message->type) {
+        case NET_ROUND:
+            startBotRound(swarm, index, message);
+            break;
+        case NET_RESULT:
+            handleResult(swarm, index, message);
+            break;
+        case NET_ERROR:
+            if (message->result == NET_ERROR_STALE) {
+                swarm->stats.stale++;
+            } else {
+                swarm->stats.errors++;
+            }
+            if (bot->sentAt != 0 && message->value == bot->sentGame) {
+                bot->sentAt = 0;
+                schedule(swarm, index, reactionTime(swarm));
+            }
+            break;
+        default:
+            disconnectBot(swarm, bot);
+            break;
+    }
+}
+
+static void readBot(Swarm *swarm, int index) {
+    Bot *bot = &swarm->bots[index];
+    while (bot->fd >= 0) {
+        ssize_t count = read(bot->fd, bot->in + bot->inBytes, IN_BUFFER_SIZE - bot->inBytes);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            disconnectBot(swarm, bot);
+            return;
+        }
+        if (count < 0) {
+            return;
+        }
+
+        size_t available = bot->inBytes + (size_t)count;
+        size_t offset = 0;
+        for (; offset + sizeof(NetMessage) <= available && bot->fd >= 0; offset += sizeof(NetMessage)) {
+            NetMessage message;
+            memcpy(&message, bot->in + offset, sizeof(message));
+            handleMessage(swarm, index, &message);
+        }
+        bot->inBytes = available - offset;
+        memmove(bot->in, bot->in + offset, bot->inBytes);
+    }
+}
+
+static void applySnapshot(Swarm *swarm, Spectator *spectator, const NetSnapshot *snapshot) {
+    swarm->stats.snapshots++;
+    if (spectator->synced && snapshot->gameNumber == spectator->gameNumber &&
+        (snapshot->foundLines[0] != spectator->foundLines[0] || snapshot->foundLines[1] != spectator->foundLines[1] ||
+         memcmp(snapshot->scores, spectator->scores, sizeof(spectator->scores)) != 0)) {
+        swarm->stats.inconsistent++;
+    }
+    if (!spectator->synced || snapshot->gameNumber != spectator->gameNumber) {
+        spectator->board = boardFromSeed(snapshot->gameNumber);
+    }
+    spectator->synced = true;
+    spectator->gameNumber = snapshot->gameNumber;
+    spectator->foundLines[0] = snapshot->foundLines[0];
+    spectator->foundLines[1] = snapshot->foundLines[1];
+    memcpy(spectator->scores, snapshot->scores, sizeof(spectator->scores));
+    spectator->remainingHaps = snapshot->remainingHaps;
+}
+
+static void applyDelta(Swarm *swarm, Spectator *spectator, const NetDelta *delta) {
+    int player = NET_DELTA_PLAYER(delta->data);
+    int value = NET_DELTA_VALUE(delta->data);
+    bool consistent = player < NET_MAX_PLAYERS;
+
+    if (delta->type == NET_DELTA_HAP) {
+        consistent = consistent && value < NUM_LINES && (spectator->board & HAP_LINES[value]) == HAP_LINES[value] &&
+                     !((spectator->foundLines[value >> 6] >> (value & 63)) & 1);
+        if (consistent) {
+            spectator->foundLines[value >> 6] |= 1ULL << (value & 63);
+            spectator->remainingHaps--;
+        }
+    } else if (delta->type == NET_DELTA_GYUL_WON) {
+        consistent = consistent && spectator->remainingHaps == 0;
+    } else if (delta->type == NET_DELTA_GYUL_WRONG) {
+        consistent = consistent && spectator->remainingHaps > 0;
+    }
+    if (consistent) {
+        spectator->scores[player] += delta->scoreDelta;
+    } else {
+        swarm->stats.inconsistent++;
+    }
+}
+
+static void readSpectator(Swarm *swarm, Spectator *spectator) {
+    while (spectator->fd >= 0) {
+        ssize_t count = read(spectator->fd, spectator->in + spectator->inBytes, SPECTATOR_BUFFER_SIZE - spectator->inBytes);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            close(spectator->fd);
+            spectator->fd = -1;
+            swarm->stats.disconnects++;
+            return;
+        }
+        if (count < 0) {
+            return;
+        }
+        swarm->stats.spectatorBytes += (uint64_t)count;
+
+        size_t available = spectator->inBytes + (size_t)count;
+        size_t offset = 0;
+        while (offset < available) {
+            int size = netFrameSize(spectator->in[offset]);
+            if (size == 0) {
+                close(spectator->fd);
+                spectator->fd = -1;
+                swarm->stats.inconsistent++;
+                return;
+            }
+            if (offset + (size_t)size > available) {
+                break;
+            }
+            if (spectator->in[offset] == NET_SNAPSHOT) {
+                NetSnapshot snapshot;
+                memcpy(&snapshot, spectator->in + offset, sizeof(snapshot));
+                applySnapshot(swarm, spectator, &snapshot);
+            } else {
+                NetDelta delta;
+                memcpy(&delta, spectator->in + offset, sizeof(delta));
+                applyDelta(swarm, spectator, &delta);
+            }
+            swarm->stats.frames++;
+            offset += (size_t)size;
+        }
+        spectator->inBytes = available - offset;
+        memmove(spectator->in, spectator->in + offset, spectator->inBytes);
+    }
+}
+
+static void runTimers(Swarm *swarm, uint64_t now) {
+    while (swarm->heap.size > 0 && swarm->heap.timers[0].deadline <= now) {
+        Timer timer = popTimer(&swarm->heap);
+        Bot *bot = &swarm->bots[timer.bot];
+        if (timer.generation == bot->timerGeneration && bot->fd >= 0) {
+            act(swarm, (int)timer.bot);
+        }
+    }
+}
+
+static void printStats(const Swarm *swarm, double seconds) {
+    char latency[160];
+    const BotStats *stats = &swarm->stats;
+    uint64_t results = stats->haps + stats->duplicates + stats->wrong + stats->gyulsWon + stats->gyulsWrong;
+    formatHistogram(latency, sizeof(latency), "latency", &stats->latency);
+    if (swarm->numSpectators > 0) {
+        printf("spectators: %d  frames: %llu  snapshots: %llu  bytes: %llu  inconsistent: %llu\n", swarm->numSpectators,
+               (unsigned long long)stats->frames, (unsigned long long)stats->snapshots,
+               (unsigned long long)stats->spectatorBytes, (unsigned long long)stats->inconsistent);
+    }
+    printf("bots: %d  seconds: %.3f  actions: %llu  results/sec: %.0f  disconnects: %llu  errors: %llu\n"
+           "haps: %llu  lost races: %llu  wrong: %llu  gyuls: %llu  early gyuls: %llu  too late: %llu  rounds seen: %llu  mean score: %.3f\n%s\n",
+           swarm->numBots, seconds, (unsigned long long)stats->actions, seconds > 0 ? results / seconds : 0.0,
+           (unsigned long long)stats->disconnects, (unsigned long long)stats->errors,
+           (unsigned long long)stats->haps, (unsigned long long)stats->duplicates, (unsigned long long)stats->wrong,
+           (unsigned long long)stats->gyulsWon, (unsigned long long)stats->gyulsWrong, (unsigned long long)stats->stale, (unsigned long long)stats->rounds,
+           swarm->numBots > 0 ? (double)stats->score / swarm->numBots : 0.0, latency);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-a address] [-n bots] [-p players per room] [-r first room] [-w spectators] [-d seconds] [-k ms] [-m percent] [-s seed]\n"
+            "  -a  server, host:port or unix:path (default %s)\n"
+            "  -n  bots to run (default %d)\n"
+            "  -p  bots per room (default %d)\n"
+            "  -r  room of the first bots, the rest fill the next rooms (default 0)\n"
+            "  -w  spectators on each of those rooms (default 0)\n"
+            "  -d  seconds to play (default %d)\n"
+            "  -k  median reaction time in ms, 0 for no delay (default %d)\n"
+            "  -m  mistake chance per action, percent (default %d)\n"
+            "  -s  64-bit seed (default 42)\n",
+            program, NET_DEFAULT_ADDRESS, DEFAULT_BOTS, DEFAULT_PLAYERS_PER_ROOM, DEFAULT_SECONDS, DEFAULT_REACTION_MS,
+            DEFAULT_MISTAKE_PERCENT);
+}
+
+int main(int argc, char **argv) {
+    const char *address = NET_DEFAULT_ADDRESS;
+    int playersPerRoom = DEFAULT_PLAYERS_PER_ROOM;
+    uint64_t firstRoom = 0;
+    double seconds = DEFAULT_SECONDS;
+    double reactionMs = DEFAULT_REACTION_MS;
+    uint64_t seed = 42;
+    int spectatorsPerRoom = 0;
+    Swarm swarm;
+
+    memset(&swarm, 0, sizeof(swarm));
+    swarm.numBots = DEFAULT_BOTS;
+    swarm.mistakePercent = DEFAULT_MISTAKE_PERCENT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            address = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            swarm.numBots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            playersPerRoom = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            firstRoom = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            spectatorsPerRoom = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            reactionMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            swarm.mistakePercent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (swarm.numBots < 1 || playersPerRoom < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    swarm.reactionNanos = reactionMs * 1e6;
+    seedRng(&swarm.rng, seed);
+    resetHistogram(&swarm.stats.latency);
+    int numRooms = (swarm.numBots + playersPerRoom - 1) / playersPerRoom;
+    swarm.numSpectators = spectatorsPerRoom > 0 ? numRooms * spectatorsPerRoom : 0;
+    swarm.bots = calloc((size_t)swarm.numBots, sizeof(Bot));
+    swarm.spectators = calloc((size_t)swarm.numSpectators + 1, sizeof(Spectator));
+    swarm.epoll = epoll_create1(0);
+    if (swarm.bots == NULL || swarm.spectators == NULL || swarm.epoll < 0) {
+        perror("bots");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+
+    // Connect and join before the clock starts
+    for (int b = 0; b < swarm.numBots; b++) {
+        Bot *bot = &swarm.bots[b];
+        bot->fd = connectTo(address);
+        if (bot->fd < 0) {
+            perror(address);
+            return 1;
+        }
+        NetMessage join = {NET_JOIN, 0, 0, 0, {0, 0, 0}, 0, firstRoom + (uint64_t)(b / playersPerRoom)};
+        struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)b}};
+        if (send(bot->fd, &join, sizeof(join), MSG_NOSIGNAL) != (ssize_t)sizeof(join) || !setNonBlocking(bot->fd) ||
+            epoll_ctl(swarm.epoll, EPOLL_CTL_ADD, bot->fd, &event) != 0) {
+            perror("join");
+            return 1;
+        }
+    }
+
+    // Spectator s is epoll entry numBots + s
+    for (int w = 0; w < swarm.numSpectators; w++) {
+        Spectator *spectator = &swarm.spectators[w];
+        spectator->fd = connectTo(address);
+        if (spectator->fd < 0) {
+            perror(address);
+            return 1;
+        }
+        NetMessage watch = {NET_WATCH, 0, 0, 0, {0, 0, 0}, 0, firstRoom + (uint64_t)(w / spectatorsPerRoom)};
+        struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)(swarm.numBots + w)}};
+        if (send(spectator->fd, &watch, sizeof(watch), MSG_NOSIGNAL) != (ssize_t)sizeof(watch) || !setNonBlocking(spectator->fd) ||
+            epoll_ctl(swarm.epoll, EPOLL_CTL_ADD, spectator->fd, &event) != 0) {
+            perror("watch");
+            return 1;
+        }
+    }
+
+    uint64_t start = monotonicNanos();
+    uint64_t end = start + (uint64_t)(seconds * 1e9);
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t now = start;
+    while (!stopRequested && now < end) {
+        uint64_t wake = end;
+        if (swarm.heap.size > 0 && swarm.heap.timers[0].deadline < wake) {
+            wake = swarm.heap.timers[0].deadline;
+        }
+        int timeout = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+        int numEvents = epoll_wait(swarm.epoll, events, MAX_EVENTS, timeout);
+        if (numEvents < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int e = 0; e < numEvents; e++) {
+            uint32_t index = events[e].data.u32;
+            if (index < (uint32_t)swarm.numBots) {
+                readBot(&swarm, (int)index);
+            } else {
+                readSpectator(&swarm, &swarm.spectators[index - (uint32_t)swarm.numBots]);
+            }
+        }
+        now = monotonicNanos();
+        runTimers(&swarm, now);
+    }
+
+    printStats(&swarm, (monotonicNanos() - start) / 1e9);
+    for (int b = 0; b < swarm.numBots; b++) {
+        disconnectBot(&swarm, &swarm.bots[b]);
+    }
+    for (int w = 0; w < swarm.numSpectators; w++) {
+        if (swarm.spectators[w].fd >= 0) {
+            close(swarm.spectators[w].fd);
+        }
+    }
+    free(swarm.spectators);
+    free(swarm.heap.timers);
+    free(swarm.bots);
+    close(swarm.epoll);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "gyulhap_canon.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t SYMMETRY_MAP[NUM_SYMMETRIES][TOTAL_COMBINATIONS];
+static uint8_t INVERSE_MAP[NUM_SYMMETRIES][TOTAL_COMBINATIONS];
+
+// Relabels the shape and color of a 9-bit slice of tiles sharing one
+// background, for each of the 6 * 6 shape / color relabelings
+static uint16_t SLICE_MAP[36][1 << 9];
+
+static const int PERMUTATIONS[6][3] = {
+    {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+};
+
+// Symmetry s = ((attributes * 6 + bg) * 6 + shape) * 6 + color, each a
+// permutation of 3: attributes picks which attribute lands in each slot,
+// the other three relabel the values of that slot
+__attribute__((constructor))
+static void initSymmetries(void) {
+    int s = 0;
+    for (int attributes = 0; attributes < 6; attributes++) {
+        for (int bg = 0; bg < 6; bg++) {
+            for (int shape = 0; shape < 6; shape++) {
+                for (int color = 0; color < 6; color++, s++) {
+                    const int *relabel[3] = {PERMUTATIONS[bg], PERMUTATIONS[shape], PERMUTATIONS[color]};
+                    for (int t = 0; t < TOTAL_COMBINATIONS; t++) {
+                        int digits[3] = {t / 9, (t / 3) % 3, t % 3};
+                        int image = 0;
+                        for (int i = 0; i < 3; i++) {
+                            image = image * 3 + relabel[i][digits[PERMUTATIONS[attributes][i]]];
+                        }
+                        SYMMETRY_MAP[s][t] = (uint8_t)image;
+                        INVERSE_MAP[s][image] = (uint8_t)t;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int shape = 0; shape < 6; shape++) {
+        for (int color = 0; color < 6; color++) {
+            for (int slice = 0; slice < (1 << 9); slice++) {
+                uint16_t image = 0;
+                for (int t = 0; t < 9; t++) {
+                    if (slice & (1 << t)) {
+                        image |= 1 << (PERMUTATIONS[shape][t / 3] * 3 + PERMUTATIONS[color][t % 3]);
+                    }
+                }
+                SLICE_MAP[shape * 6 + color][slice] = image;
+            }
+        }
+    }
+}
+
+static BoardMask mapBoard(BoardMask board, const uint8_t *map) {
+    BoardMask image = 0;
+    while (board != 0) {
+        image |= (BoardMask)1 << map[__builtin_ctz(board)];
+        board &= board - 1;
+    }
+    return image;
+}
+
+BoardMask transformBoard(BoardMask board, int symmetry) {
+    return mapBoard(board, SYMMETRY_MAP[symmetry]);
+}
+
+BoardMask untransformBoard(BoardMask board, int symmetry) {
+    return mapBoard(board, INVERSE_MAP[symmetry]);
+}
+
+// Smallest image over all symmetries. symmetry (optional) gets one that
+// maps the board onto it.
+//
+// The background slot is the most significant, so once the attributes are
+// placed and shape / color relabeled, the best background relabeling just
+// sends the smallest 9-bit slice to the top: 6 * 36 candidates instead of
+// all 1296.
+BoardMask canonicalBoard(BoardMask board, int *symmetry) {
+    BoardMask best = ~(BoardMask)0;
+    int bestSymmetry = 0;
+
+    for (int attributes = 0; attributes < 6; attributes++) {
+        BoardMask placed = transformBoard(board, attributes * 216);
+        uint16_t slices[3] = {placed & 0x1FF, (placed >> 9) & 0x1FF, placed >> 18};
+
+        for (int relabel = 0; relabel < 36; relabel++) {
+            uint16_t values[3] = {
+                SLICE_MAP[relabel][slices[0]], SLICE_MAP[relabel][slices[1]], SLICE_MAP[relabel][slices[2]]
+            };
+
+            // Order the backgrounds by slice, smallest slice gets background 2
+            int low = 0, mid = 1, high = 2;
+            if (values[low] > values[mid]) { int t = low; low = mid; mid = t; }
+            if (values[mid] > values[high]) { int t = mid; mid = high; high = t; }
+            if (values[low] > values[mid]) { int t = low; low = mid; mid = t; }
+
+            BoardMask image = ((BoardMask)values[low] << 18) | ((BoardMask)values[mid] << 9) | values[high];
+            if (image < best) {
+                int bg[3];
+                bg[low] = 2;
+                bg[mid] = 1;
+                bg[high] = 0;
+
+                int bgPermutation = 0;
+                while (PERMUTATIONS[bgPermutation][0] != bg[0] || PERMUTATIONS[bgPermutation][1] != bg[1]) {
+                    bgPermutation++;
+                }
+                best = image;
+                bestSymmetry = (attributes * 6 + bgPermutation) * 36 + relabel;
+            }
+        }
+    }
+
+    if (symmetry != NULL) {
+        *symmetry = bestSymmetry;
+    }
+    return best;
+}
+
+bool initSolutionCache(SolutionCache *cache, uint32_t capacity) {
+    memset(cache, 0, sizeof(*cache));
+
+    // Power of two, kept at most half full
+    uint32_t slots = 16;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+    cache->entries = calloc(slots, sizeof(CachedSolution));
+    if (cache->entries == NULL) {
+        return false;
+    }
+    cache->capacity = slots;
+    return true;
+}
+
+void freeSolutionCache(SolutionCache *cache) {
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static void solveCanonical(CachedSolution *entry, BoardMask canonical) {
+    entry->canonical = canonical;
+    entry->numHaps = 0;
+    for (int l = 0; l < NUM_LINES && entry->numHaps < CACHE_MAX_HAPS; l++) {
+        if ((canonical & HAP_LINES[l]) == HAP_LINES[l]) {
+            entry->lines[entry->numHaps++] = (uint8_t)l;
+        }
+    }
+}
+
+// Solution of a 9-tile board, from the cache when an equivalent board was
+// solved before. symmetry gets the map from the board to the cached form.
+const CachedSolution *solveCached(SolutionCache *cache, BoardMask board, int *symmetry) {
+    BoardMask canonical = canonicalBoard(board, symmetry);
+    uint32_t slot = (canonical * 0x9E3779B1u) & (cache->capacity - 1);
+
+    while (cache->entries[slot].canonical != 0) {
+        if (cache->entries[slot].canonical == canonical) {
+            cache->hits++;
+            cache->entries[slot].timesSeen++;
+            return &cache->entries[slot];
+        }
+        slot = (slot + 1) & (cache->capacity - 1);
+    }
+
+    cache->misses++;
+    CachedSolution *entry = &cache->entries[slot];
+    if (cache->size * 2 >= cache->capacity) {
+        entry = &cache->overflow;
+    } else {
+        cache->size++;
+    }
+    solveCanonical(entry, canonical);
+    entry->timesSeen = 1;
+    return entry;
+}
+
+// Maps the cached lines back onto the board solveCached was called with,
+// in increasing HAP_LINES order. Returns the number of haps.
+int solutionLines(const CachedSolution *solution, int symmetry, uint8_t *lines) {
+    for (int h = 0; h < solution->numHaps; h++) {
+        TileId lineTiles[3];
+        maskToTiles(untransformBoard(HAP_LINES[solution->lines[h]], symmetry), lineTiles);
+        uint8_t line = HAP_LINE_OF[lineTiles[0]][lineTiles[1]];
+
+        int i = h;
+        for (; i > 0 && lines[i - 1] > line; i--) {
+            lines[i] = lines[i - 1];
+        }
+        lines[i] = line;
+    }
+    return solution->numHaps;
+}
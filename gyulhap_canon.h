@@ -0,0 +1,40 @@
+#ifndef GYULHAP_CANON_H
+#define GYULHAP_CANON_H
+
+#include "gyulhap_core.h"
+
+// Boards that only differ by relabeling the values of an attribute or by
+// swapping attributes are the same puzzle. These 6 * 6^3 = 1296 symmetries
+// map haps to haps, so the smallest image of a board is a canonical form
+// that every equivalent board shares.
+
+#define NUM_SYMMETRIES 1296
+#define CACHE_MAX_HAPS 12 // Solutions are cached for 9-tile boards
+
+BoardMask transformBoard(BoardMask board, int symmetry);
+BoardMask untransformBoard(BoardMask board, int symmetry);
+BoardMask canonicalBoard(BoardMask board, int *symmetry);
+
+typedef struct {
+    BoardMask canonical; // 0 marks an empty slot
+    uint32_t timesSeen;
+    uint8_t numHaps;
+    uint8_t lines[CACHE_MAX_HAPS]; // HAP_LINES indices on the canonical board
+} CachedSolution;
+
+// Open-addressed table of solved canonical boards
+typedef struct {
+    CachedSolution *entries;
+    CachedSolution overflow; // Handed out uncached once the table is full
+    uint32_t capacity;
+    uint32_t size;
+    uint64_t hits;
+    uint64_t misses;
+} SolutionCache;
+
+bool initSolutionCache(SolutionCache *cache, uint32_t capacity);
+void freeSolutionCache(SolutionCache *cache);
+const CachedSolution *solveCached(SolutionCache *cache, BoardMask board, int *symmetry);
+int solutionLines(const CachedSolution *solution, int symmetry, uint8_t *lines);
+
+#endif
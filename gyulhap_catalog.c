@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_catalog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool writeCatalog(const char *path) {
+    CatalogHeader header;
+    uint8_t *counts = malloc(NUM_BOARDS);
+    uint32_t *ranks = malloc(NUM_BOARDS * sizeof(uint32_t));
+    bool ok = false;
+
+    if (counts == NULL || ranks == NULL) {
+        goto done;
+    }
+
+    // Pass 1: hap count of every board
+    BoardMask board = (1u << NUM_TILES) - 1;
+    BoardMask boards[4096];
+    for (uint32_t rank = 0; rank < NUM_BOARDS;) {
+        int blockBoards = 0;
+        for (; blockBoards < 4096 && rank + blockBoards < NUM_BOARDS; blockBoards++) {
+            boards[blockBoards] = board;
+            board = nextBoard(board);
+        }
+        countHapsMaskBatch(boards, counts + rank, blockBoards);
+        rank += blockBoards;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.numBoards = NUM_BOARDS;
+    header.numTiles = NUM_TILES;
+    for (uint32_t rank = 0; rank < NUM_BOARDS; rank++) {
+        header.groupStart[counts[rank] + 1]++;
+    }
+    for (int k = 0; k <= CATALOG_MAX_HAPS; k++) {
+        uint32_t groupSize = header.groupStart[k + 1];
+        header.groupStart[k + 1] = header.groupStart[k] + groupSize;
+    }
+    header.ranksOffset = sizeof(CatalogHeader);
+
+    // Pass 2: place every board in its group
+    uint32_t next[CATALOG_MAX_HAPS + 1];
+    memcpy(next, header.groupStart, sizeof(next));
+    for (uint32_t rank = 0; rank < NUM_BOARDS; rank++) {
+        ranks[next[counts[rank]]++] = rank;
+    }
+
+    // Written under a temporary name so a half-written catalogue is never opened
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        goto done;
+    }
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(ranks, sizeof(uint32_t), NUM_BOARDS, file) == NUM_BOARDS;
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && rename(tmpPath, path) == 0;
+    if (!ok) {
+        remove(tmpPath);
+    }
+
+done:
+    free(counts);
+    free(ranks);
+    return ok;
+}
+
+// Groups in order and every rank inside the file
+static bool isCatalogHeader(const CatalogHeader *header, size_t size) {
+    if (memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) != 0 || header->numBoards != NUM_BOARDS ||
+        header->numTiles != NUM_TILES || header->groupStart[0] != 0 ||
+        header->groupStart[CATALOG_MAX_HAPS + 1] != NUM_BOARDS || header->ranksOffset % sizeof(uint32_t) != 0 ||
+        header->ranksOffset < sizeof(CatalogHeader) || header->ranksOffset > size ||
+        (size - header->ranksOffset) / sizeof(uint32_t) < NUM_BOARDS) {
+        return false;
+    }
+    for (int k = 0; k <= CATALOG_MAX_HAPS; k++) {
+        if (header->groupStart[k] > header->groupStart[k + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool openCatalog(BoardCatalog *catalog, const char *path) {
+    memset(catalog, 0, sizeof(*catalog));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CatalogHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const CatalogHeader *header = data;
+    if (!isCatalogHeader(header, (size_t)st.st_size)) {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+
+    catalog->data = data;
+    catalog->size = (size_t)st.st_size;
+    catalog->header = header;
+    catalog->ranks = (const uint32_t *)((const uint8_t *)data + header->ranksOffset);
+    return true;
+}
+
+void closeCatalog(BoardCatalog *catalog) {
+    if (catalog->data != NULL) {
+        munmap(catalog->data, catalog->size);
+    }
+    memset(catalog, 0, sizeof(*catalog));
+}
+
+uint32_t catalogCount(const BoardCatalog *catalog, int numHaps) {
+    if (catalog->header == NULL || numHaps < 0 || numHaps > CATALOG_MAX_HAPS) {
+        return 0;
+    }
+    return catalog->header->groupStart[numHaps + 1] - catalog->header->groupStart[numHaps];
+}
+
+// index must be below catalogCount(numHaps)
+BoardMask catalogBoard(const BoardCatalog *catalog, int numHaps, uint32_t index) {
+    const CatalogHeader *header = catalog->header;
+    return unrankBoard(catalog->ranks[header->groupStart[numHaps] + index]);
+}
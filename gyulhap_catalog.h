@@ -0,0 +1,41 @@
+#ifndef GYULHAP_CATALOG_H
+#define GYULHAP_CATALOG_H
+
+#include "gyulhap_core.h"
+#include <stddef.h>
+
+// Every 9-tile board, grouped by hap count.
+//
+// File layout (native endian):
+//   CatalogHeader
+//   uint32_t ranks[NUM_BOARDS]   colex ranks, group 0 first, ascending within a group
+//
+// Solutions aren't stored, startRound works out a board's lines from its
+// tiles when the round is dealt.
+
+#define CATALOG_MAGIC "GYULCAT2"
+#define CATALOG_PATH "gyulhap.cat"
+#define CATALOG_MAX_HAPS 12 // A 9-tile board has at most 12 haps (a full plane)
+
+typedef struct {
+    char magic[8];
+    uint32_t numBoards;
+    uint32_t numTiles;
+    uint32_t groupStart[CATALOG_MAX_HAPS + 2]; // Index of the first board with k haps
+    uint64_t ranksOffset;
+} CatalogHeader;
+
+typedef struct {
+    void *data;
+    size_t size;
+    const CatalogHeader *header;
+    const uint32_t *ranks;
+} BoardCatalog;
+
+bool writeCatalog(const char *path);
+bool openCatalog(BoardCatalog *catalog, const char *path);
+void closeCatalog(BoardCatalog *catalog);
+uint32_t catalogCount(const BoardCatalog *catalog, int numHaps);
+BoardMask catalogBoard(const BoardCatalog *catalog, int numHaps, uint32_t index);
+
+#endif
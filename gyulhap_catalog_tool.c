@@ -0,0 +1,52 @@
+#include "gyulhap_catalog.h"
+#include <stdio.h>
+#include <string.h>
+
+// One-time generator for the board catalogue, also prints group sizes
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-o file] [-i file]\n"
+            "  -o  write the catalogue (default " CATALOG_PATH ")\n"
+            "  -i  print the boards per hap count of an existing catalogue\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    const char *outPath = CATALOG_PATH;
+    const char *inPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            inPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (inPath == NULL) {
+        if (!writeCatalog(outPath)) {
+            perror(outPath);
+            return 1;
+        }
+        inPath = outPath;
+    }
+
+    BoardCatalog catalog;
+    if (!openCatalog(&catalog, inPath)) {
+        fprintf(stderr, "%s: not a board catalogue\n", inPath);
+        return 1;
+    }
+    printf("%s: %zu bytes\n", inPath, catalog.size);
+    for (int k = 0; k <= CATALOG_MAX_HAPS; k++) {
+        uint32_t count = catalogCount(&catalog, k);
+        if (count > 0) {
+            printf("haps %2d: %u\n", k, count);
+        }
+    }
+    closeCatalog(&catalog);
+    return 0;
+}
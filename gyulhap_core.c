@@ -0,0 +1,489 @@
+#include "gyulhap_core.h"
+#include <stdlib.h>
+
+const TileId THIRD_TILE[TOTAL_COMBINATIONS][TOTAL_COMBINATIONS] = {
+    { 0,  2,  1,  6,  8,  7,  3,  5,  4, 18, 20, 19, 24, 26, 25, 21, 23, 22,  9, 11, 10, 15, 17, 16, 12, 14, 13},
+    { 2,  1,  0,  8,  7,  6,  5,  4,  3, 20, 19, 18, 26, 25, 24, 23, 22, 21, 11, 10,  9, 17, 16, 15, 14, 13, 12},
+    { 1,  0,  2,  7,  6,  8,  4,  3,  5, 19, 18, 20, 25, 24, 26, 22, 21, 23, 10,  9, 11, 16, 15, 17, 13, 12, 14},
+    { 6,  8,  7,  3,  5,  4,  0,  2,  1, 24, 26, 25, 21, 23, 22, 18, 20, 19, 15, 17, 16, 12, 14, 13,  9, 11, 10},
+    { 8,  7,  6,  5,  4,  3,  2,  1,  0, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10,  9},
+    { 7,  6,  8,  4,  3,  5,  1,  0,  2, 25, 24, 26, 22, 21, 23, 19, 18, 20, 16, 15, 17, 13, 12, 14, 10,  9, 11},
+    { 3,  5,  4,  0,  2,  1,  6,  8,  7, 21, 23, 22, 18, 20, 19, 24, 26, 25, 12, 14, 13,  9, 11, 10, 15, 17, 16},
+    { 5,  4,  3,  2,  1,  0,  8,  7,  6, 23, 22, 21, 20, 19, 18, 26, 25, 24, 14, 13, 12, 11, 10,  9, 17, 16, 15},
+    { 4,  3,  5,  1,  0,  2,  7,  6,  8, 22, 21, 23, 19, 18, 20, 25, 24, 26, 13, 12, 14, 10,  9, 11, 16, 15, 17},
+    {18, 20, 19, 24, 26, 25, 21, 23, 22,  9, 11, 10, 15, 17, 16, 12, 14, 13,  0,  2,  1,  6,  8,  7,  3,  5,  4},
+    {20, 19, 18, 26, 25, 24, 23, 22, 21, 11, 10,  9, 17, 16, 15, 14, 13, 12,  2,  1,  0,  8,  7,  6,  5,  4,  3},
+    {19, 18, 20, 25, 24, 26, 22, 21, 23, 10,  9, 11, 16, 15, 17, 13, 12, 14,  1,  0,  2,  7,  6,  8,  4,  3,  5},
+    {24, 26, 25, 21, 23, 22, 18, 20, 19, 15, 17, 16, 12, 14, 13,  9, 11, 10,  6,  8,  7,  3,  5,  4,  0,  2,  1},
+    {26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0},
+    {25, 24, 26, 22, 21, 23, 19, 18, 20, 16, 15, 17, 13, 12, 14, 10,  9, 11,  7,  6,  8,  4,  3,  5,  1,  0,  2},
+    {21, 23, 22, 18, 20, 19, 24, 26, 25, 12, 14, 13,  9, 11, 10, 15, 17, 16,  3,  5,  4,  0,  2,  1,  6,  8,  7},
+    {23, 22, 21, 20, 19, 18, 26, 25, 24, 14, 13, 12, 11, 10,  9, 17, 16, 15,  5,  4,  3,  2,  1,  0,  8,  7,  6},
+    {22, 21, 23, 19, 18, 20, 25, 24, 26, 13, 12, 14, 10,  9, 11, 16, 15, 17,  4,  3,  5,  1,  0,  2,  7,  6,  8},
+    { 9, 11, 10, 15, 17, 16, 12, 14, 13,  0,  2,  1,  6,  8,  7,  3,  5,  4, 18, 20, 19, 24, 26, 25, 21, 23, 22},
+    {11, 10,  9, 17, 16, 15, 14, 13, 12,  2,  1,  0,  8,  7,  6,  5,  4,  3, 20, 19, 18, 26, 25, 24, 23, 22, 21},
+    {10,  9, 11, 16, 15, 17, 13, 12, 14,  1,  0,  2,  7,  6,  8,  4,  3,  5, 19, 18, 20, 25, 24, 26, 22, 21, 23},
+    {15, 17, 16, 12, 14, 13,  9, 11, 10,  6,  8,  7,  3,  5,  4,  0,  2,  1, 24, 26, 25, 21, 23, 22, 18, 20, 19},
+    {17, 16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0, 26, 25, 24, 23, 22, 21, 20, 19, 18},
+    {16, 15, 17, 13, 12, 14, 10,  9, 11,  7,  6,  8,  4,  3,  5,  1,  0,  2, 25, 24, 26, 22, 21, 23, 19, 18, 20},
+    {12, 14, 13,  9, 11, 10, 15, 17, 16,  3,  5,  4,  0,  2,  1,  6,  8,  7, 21, 23, 22, 18, 20, 19, 24, 26, 25},
+    {14, 13, 12, 11, 10,  9, 17, 16, 15,  5,  4,  3,  2,  1,  0,  8,  7,  6, 23, 22, 21, 20, 19, 18, 26, 25, 24},
+    {13, 12, 14, 10,  9, 11, 16, 15, 17,  4,  3,  5,  1,  0,  2,  7,  6,  8, 22, 21, 23, 19, 18, 20, 25, 24, 26},
+};
+
+const BoardMask HAP_LINES[NUM_LINES] = {
+    0x0000007, 0x0000049, 0x0000111, 0x00000A1, 0x0040201, 0x0100401,
+    0x0080801, 0x1001001, 0x4002001, 0x2004001, 0x0208001, 0x0810001,
+    0x0420001, 0x000010A, 0x0000092, 0x0000062, 0x0100202, 0x0080402,
+    0x0040802, 0x4001002, 0x2002002, 0x1004002, 0x0808002, 0x0410002,
+    0x0220002, 0x000008C, 0x0000054, 0x0000124, 0x0080204, 0x0040404,
+    0x0100804, 0x2001004, 0x1002004, 0x4004004, 0x0408004, 0x0210004,
+    0x0820004, 0x0000038, 0x1000208, 0x4000408, 0x2000808, 0x0201008,
+    0x0802008, 0x0404008, 0x0048008, 0x0110008, 0x00A0008, 0x4000210,
+    0x2000410, 0x1000810, 0x0801010, 0x0402010, 0x0204010, 0x0108010,
+    0x0090010, 0x0060010, 0x2000220, 0x1000420, 0x4000820, 0x0401020,
+    0x0202020, 0x0804020, 0x0088020, 0x0050020, 0x0120020, 0x00001C0,
+    0x0200240, 0x0800440, 0x0400840, 0x0041040, 0x0102040, 0x0084040,
+    0x1008040, 0x4010040, 0x2020040, 0x0800280, 0x0400480, 0x0200880,
+    0x0101080, 0x0082080, 0x0044080, 0x4008080, 0x2010080, 0x1020080,
+    0x0400300, 0x0200500, 0x0800900, 0x0081100, 0x0042100, 0x0104100,
+    0x2008100, 0x1010100, 0x4020100, 0x0000E00, 0x0009200, 0x0022200,
+    0x0014200, 0x0021400, 0x0012400, 0x000C400, 0x0011800, 0x000A800,
+    0x0024800, 0x0007000, 0x0038000, 0x01C0000, 0x1240000, 0x4440000,
+    0x2840000, 0x4280000, 0x2480000, 0x1880000, 0x2300000, 0x1500000,
+    0x4900000, 0x0E00000, 0x7000000,
+};
+
+const uint8_t HAP_LINE_OF[TOTAL_COMBINATIONS][TOTAL_COMBINATIONS] = {
+    {255,   0,   0,   1,   2,   3,   1,   3,   2,   4,   5,   6,   7,   8,   9,  10,  11,  12,   4,   6,   5,  10,  12,  11,   7,   9,   8},
+    {  0, 255,   0,  13,  14,  15,  15,  14,  13,  16,  17,  18,  19,  20,  21,  22,  23,  24,  18,  17,  16,  24,  23,  22,  21,  20,  19},
+    {  0,   0, 255,  25,  26,  27,  26,  25,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  29,  28,  30,  35,  34,  36,  32,  31,  33},
+    {  1,  13,  25, 255,  37,  37,   1,  25,  13,  38,  39,  40,  41,  42,  43,  44,  45,  46,  44,  46,  45,  41,  43,  42,  38,  40,  39},
+    {  2,  14,  26,  37, 255,  37,  26,  14,   2,  47,  48,  49,  50,  51,  52,  53,  54,  55,  55,  54,  53,  52,  51,  50,  49,  48,  47},
+    {  3,  15,  27,  37,  37, 255,  15,   3,  27,  56,  57,  58,  59,  60,  61,  62,  63,  64,  63,  62,  64,  60,  59,  61,  57,  56,  58},
+    {  1,  15,  26,   1,  26,  15, 255,  65,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  69,  71,  70,  66,  68,  67,  72,  74,  73},
+    {  3,  14,  25,  25,  14,   3,  65, 255,  65,  75,  76,  77,  78,  79,  80,  81,  82,  83,  80,  79,  78,  77,  76,  75,  83,  82,  81},
+    {  2,  13,  27,  13,   2,  27,  65,  65, 255,  84,  85,  86,  87,  88,  89,  90,  91,  92,  88,  87,  89,  85,  84,  86,  91,  90,  92},
+    {  4,  16,  28,  38,  47,  56,  66,  75,  84, 255,  93,  93,  94,  95,  96,  94,  96,  95,   4,  28,  16,  66,  84,  75,  38,  56,  47},
+    {  5,  17,  29,  39,  48,  57,  67,  76,  85,  93, 255,  93,  97,  98,  99,  99,  98,  97,  29,  17,   5,  85,  76,  67,  57,  48,  39},
+    {  6,  18,  30,  40,  49,  58,  68,  77,  86,  93,  93, 255, 100, 101, 102, 101, 100, 102,  18,   6,  30,  77,  68,  86,  49,  40,  58},
+    {  7,  19,  31,  41,  50,  59,  69,  78,  87,  94,  97, 100, 255, 103, 103,  94, 100,  97,  69,  87,  78,  41,  59,  50,   7,  31,  19},
+    {  8,  20,  32,  42,  51,  60,  70,  79,  88,  95,  98, 101, 103, 255, 103, 101,  98,  95,  88,  79,  70,  60,  51,  42,  32,  20,   8},
+    {  9,  21,  33,  43,  52,  61,  71,  80,  89,  96,  99, 102, 103, 103, 255,  99,  96, 102,  80,  71,  89,  52,  43,  61,  21,   9,  33},
+    { 10,  22,  34,  44,  53,  62,  72,  81,  90,  94,  99, 101,  94, 101,  99, 255, 104, 104,  44,  62,  53,  10,  34,  22,  72,  90,  81},
+    { 11,  23,  35,  45,  54,  63,  73,  82,  91,  96,  98, 100, 100,  98,  96, 104, 255, 104,  63,  54,  45,  35,  23,  11,  91,  82,  73},
+    { 12,  24,  36,  46,  55,  64,  74,  83,  92,  95,  97, 102,  97,  95, 102, 104, 104, 255,  55,  46,  64,  24,  12,  36,  83,  74,  92},
+    {  4,  18,  29,  44,  55,  63,  69,  80,  88,   4,  29,  18,  69,  88,  80,  44,  63,  55, 255, 105, 105, 106, 107, 108, 106, 108, 107},
+    {  6,  17,  28,  46,  54,  62,  71,  79,  87,  28,  17,   6,  87,  79,  71,  62,  54,  46, 105, 255, 105, 109, 110, 111, 111, 110, 109},
+    {  5,  16,  30,  45,  53,  64,  70,  78,  89,  16,   5,  30,  78,  70,  89,  53,  45,  64, 105, 105, 255, 112, 113, 114, 113, 112, 114},
+    { 10,  24,  35,  41,  52,  60,  66,  77,  85,  66,  85,  77,  41,  60,  52,  10,  35,  24, 106, 109, 112, 255, 115, 115, 106, 112, 109},
+    { 12,  23,  34,  43,  51,  59,  68,  76,  84,  84,  76,  68,  59,  51,  43,  34,  23,  12, 107, 110, 113, 115, 255, 115, 113, 110, 107},
+    { 11,  22,  36,  42,  50,  61,  67,  75,  86,  75,  67,  86,  50,  42,  61,  22,  11,  36, 108, 111, 114, 115, 115, 255, 111, 108, 114},
+    {  7,  21,  32,  38,  49,  57,  72,  83,  91,  38,  57,  49,   7,  32,  21,  72,  91,  83, 106, 111, 113, 106, 113, 111, 255, 116, 116},
+    {  9,  20,  31,  40,  48,  56,  74,  82,  90,  56,  48,  40,  31,  20,   9,  90,  82,  74, 108, 110, 112, 112, 110, 108, 116, 255, 116},
+    {  8,  19,  33,  39,  47,  58,  73,  81,  92,  47,  39,  58,  19,   8,  33,  81,  73,  92, 107, 109, 114, 109, 107, 114, 116, 116, 255},
+};
+
+// BINOMIAL[n][k] = C(n, k), enough for ranking 9-tile boards
+static const uint32_t BINOMIAL[TOTAL_COMBINATIONS + 1][NUM_TILES + 1] = {
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 2, 1, 0, 0, 0, 0, 0, 0, 0},
+    {1, 3, 3, 1, 0, 0, 0, 0, 0, 0},
+    {1, 4, 6, 4, 1, 0, 0, 0, 0, 0},
+    {1, 5, 10, 10, 5, 1, 0, 0, 0, 0},
+    {1, 6, 15, 20, 15, 6, 1, 0, 0, 0},
+    {1, 7, 21, 35, 35, 21, 7, 1, 0, 0},
+    {1, 8, 28, 56, 70, 56, 28, 8, 1, 0},
+    {1, 9, 36, 84, 126, 126, 84, 36, 9, 1},
+    {1, 10, 45, 120, 210, 252, 210, 120, 45, 10},
+    {1, 11, 55, 165, 330, 462, 462, 330, 165, 55},
+    {1, 12, 66, 220, 495, 792, 924, 792, 495, 220},
+    {1, 13, 78, 286, 715, 1287, 1716, 1716, 1287, 715},
+    {1, 14, 91, 364, 1001, 2002, 3003, 3432, 3003, 2002},
+    {1, 15, 105, 455, 1365, 3003, 5005, 6435, 6435, 5005},
+    {1, 16, 120, 560, 1820, 4368, 8008, 11440, 12870, 11440},
+    {1, 17, 136, 680, 2380, 6188, 12376, 19448, 24310, 24310},
+    {1, 18, 153, 816, 3060, 8568, 18564, 31824, 43758, 48620},
+    {1, 19, 171, 969, 3876, 11628, 27132, 50388, 75582, 92378},
+    {1, 20, 190, 1140, 4845, 15504, 38760, 77520, 125970, 167960},
+    {1, 21, 210, 1330, 5985, 20349, 54264, 116280, 203490, 293930},
+    {1, 22, 231, 1540, 7315, 26334, 74613, 170544, 319770, 497420},
+    {1, 23, 253, 1771, 8855, 33649, 100947, 245157, 490314, 817190},
+    {1, 24, 276, 2024, 10626, 42504, 134596, 346104, 735471, 1307504},
+    {1, 25, 300, 2300, 12650, 53130, 177100, 480700, 1081575, 2042975},
+    {1, 26, 325, 2600, 14950, 65780, 230230, 657800, 1562275, 3124550},
+    {1, 27, 351, 2925, 17550, 80730, 296010, 888030, 2220075, 4686825},
+};
+
+bool areAllSameOrAllDifferent(int value1, int value2, int value3) {
+    return (value1 == value2 && value2 == value3) || (value1 != value2 && value2 != value3 && value1 != value3);
+}
+
+bool compareTiles(Tile *tiles1, Tile *tiles2) {
+    for (int i = 0; i < 3; i++) {
+        bool found = false;
+        for (int j = 0; j < 3; j++) {
+            if (tiles1[i].backgroundColor == tiles2[j].backgroundColor &&
+                tiles1[i].shape == tiles2[j].shape &&
+                tiles1[i].shapeColor == tiles2[j].shapeColor) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isValidHap(Tile tile1, Tile tile2, Tile tile3) {
+    bool backgroundColorCondition = areAllSameOrAllDifferent(tile1.backgroundColor, tile2.backgroundColor, tile3.backgroundColor);
+    bool shapeCondition = areAllSameOrAllDifferent(tile1.shape, tile2.shape, tile3.shape);
+    bool shapeColorCondition = areAllSameOrAllDifferent(tile1.shapeColor, tile2.shapeColor, tile3.shapeColor);
+    return backgroundColorCondition && shapeCondition && shapeColorCondition;
+}
+
+TileId tileToId(Tile tile) {
+    return (TileId)(tile.backgroundColor * 9 + tile.shape * 3 + tile.shapeColor);
+}
+
+Tile tileFromId(TileId id) {
+    Tile tile;
+    tile.backgroundColor = (BackgroundColor)(id / 9);
+    tile.shape = (Shape)((id / 3) % 3);
+    tile.shapeColor = (ShapeColor)(id % 3);
+    return tile;
+}
+
+bool isValidHapPacked(TileId tile1, TileId tile2, TileId tile3) {
+    return THIRD_TILE[tile1][tile2] == tile3;
+}
+
+// Board tiles must be distinct. Every pair has exactly one completing tile,
+// so each hap is seen once from each of its 3 pairs.
+int countHapsPacked(const TileId *boardTiles, int numTiles) {
+    uint32_t present = 0;
+    int numPairs = 0;
+
+    for (int i = 0; i < numTiles; i++) {
+        present |= 1u << boardTiles[i];
+    }
+
+    for (int i = 0; i < numTiles - 1; i++) {
+        const TileId *thirds = THIRD_TILE[boardTiles[i]];
+        for (int j = i + 1; j < numTiles; j++) {
+            numPairs += (present >> thirds[boardTiles[j]]) & 1;
+        }
+    }
+
+    return numPairs / 3;
+}
+
+// A hap (i, j, k) is recorded from its first two positions, which keeps
+// the (i, j, k) order of the old triple loop
+int findHapsPacked(const TileId *boardTiles, int numTiles, uint8_t (*hapPositions)[3]) {
+    int8_t position[TOTAL_COMBINATIONS];
+    int numHaps = 0;
+
+    for (int t = 0; t < TOTAL_COMBINATIONS; t++) {
+        position[t] = -1;
+    }
+    for (int i = 0; i < numTiles; i++) {
+        position[boardTiles[i]] = (int8_t)i;
+    }
+
+    for (int i = 0; i < numTiles - 2; i++) {
+        const TileId *thirds = THIRD_TILE[boardTiles[i]];
+        for (int j = i + 1; j < numTiles - 1; j++) {
+            int k = position[thirds[boardTiles[j]]];
+            if (k > j) {
+                hapPositions[numHaps][0] = (uint8_t)i;
+                hapPositions[numHaps][1] = (uint8_t)j;
+                hapPositions[numHaps][2] = (uint8_t)k;
+                numHaps++;
+            }
+        }
+    }
+
+    return numHaps;
+}
+
+BoardMask boardToMask(const TileId *boardTiles, int numTiles) {
+    BoardMask board = 0;
+    for (int i = 0; i < numTiles; i++) {
+        board |= (BoardMask)1 << boardTiles[i];
+    }
+    return board;
+}
+
+// Nine distinct tiles, for masks read from a file
+bool isBoardMask(BoardMask board) {
+    return board >> TOTAL_COMBINATIONS == 0 && __builtin_popcount(board) == NUM_TILES;
+}
+
+// Every hap is a line of AG(3, 3), so count the lines fully on the board
+int countHapsMask(BoardMask board) {
+    int numHaps = 0;
+    for (int l = 0; l < NUM_LINES; l++) {
+        numHaps += (board & HAP_LINES[l]) == HAP_LINES[l];
+    }
+    return numHaps;
+}
+
+// Tiles in increasing TileId order, returns how many
+int maskToTiles(BoardMask board, TileId *boardTiles) {
+    int numTiles = 0;
+    while (board != 0) {
+        boardTiles[numTiles++] = (TileId)__builtin_ctz(board);
+        board &= board - 1;
+    }
+    return numTiles;
+}
+
+// Colex rank of a 9-tile board in [0, NUM_BOARDS). Boards in increasing
+// mask order have increasing ranks.
+uint32_t rankBoard(BoardMask board) {
+    uint32_t rank = 0;
+    for (int i = 1; board != 0; i++) {
+        rank += BINOMIAL[__builtin_ctz(board)][i];
+        board &= board - 1;
+    }
+    return rank;
+}
+
+BoardMask unrankBoard(uint32_t rank) {
+    BoardMask board = 0;
+    int tile = TOTAL_COMBINATIONS - 1;
+    for (int i = NUM_TILES; i > 0; i--) {
+        while (BINOMIAL[tile][i] > rank) {
+            tile--;
+        }
+        rank -= BINOMIAL[tile][i];
+        board |= (BoardMask)1 << tile;
+        tile--;
+    }
+    return board;
+}
+
+// Next larger mask with the same number of tiles (Gosper's hack). Starting
+// from the lowest 9 bits this walks the boards in colex rank order.
+BoardMask nextBoard(BoardMask board) {
+    BoardMask lowest = board & -board;
+    BoardMask ripple = board + lowest;
+    return ripple | (((board ^ ripple) >> 2) / lowest);
+}
+
+int countAllHaps(Tile *boardTiles, int numTiles) {
+    BoardMask board = 0;
+    for (int i = 0; i < numTiles; i++) {
+        board |= (BoardMask)1 << tileToId(boardTiles[i]);
+    }
+    return countHapsMask(board);
+}
+
+// Any board of distinct tiles, up to all TOTAL_COMBINATIONS of them; each
+// hap is then a different line, so haps needs room for NUM_LINES at most.
+// A larger board can't be distinct and finds nothing.
+void findAllHaps(Tile *boardTiles, int numTiles, Tile (*haps)[3]) {
+    TileId packed[TOTAL_COMBINATIONS];
+    uint8_t hapPositions[NUM_LINES][3];
+    if (numTiles > TOTAL_COMBINATIONS) {
+        return;
+    }
+    for (int i = 0; i < numTiles; i++) {
+        packed[i] = tileToId(boardTiles[i]);
+    }
+
+    int numHaps = findHapsPacked(packed, numTiles, hapPositions);
+    for (int h = 0; h < numHaps; h++) {
+        haps[h][0] = boardTiles[hapPositions[h][0]];
+        haps[h][1] = boardTiles[hapPositions[h][1]];
+        haps[h][2] = boardTiles[hapPositions[h][2]];
+    }
+}
+
+// Fills the array with the 27 unique tiles
+void initTileDeck(Tile *tilesArray) {
+    int index = 0;
+    for (int bg = 0; bg < 3; bg++) {
+        for (int shape = 0; shape < 3; shape++) {
+            for (int color = 0; color < 3; color++) {
+                tilesArray[index].backgroundColor = (BackgroundColor)bg;
+                tilesArray[index].shape = (Shape)shape;
+                tilesArray[index].shapeColor = (ShapeColor)color;
+                index++;
+            }
+        }
+    }
+}
+
+void shuffleArray(Tile *array, int size) {
+    for (int i = size - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        Tile temp = array[i];
+        array[i] = array[j];
+        array[j] = temp;
+    }
+}
+
+static void setLine(uint64_t *lines, int line) {
+    lines[line >> 6] |= 1ULL << (line & 63);
+}
+
+static void clearLine(uint64_t *lines, int line) {
+    lines[line >> 6] &= ~(1ULL << (line & 63));
+}
+
+static int countLines(const uint64_t *lines) {
+    return __builtin_popcountll(lines[0]) + __builtin_popcountll(lines[1]);
+}
+
+// Haps through the tile at position: one pair lookup per other tile. Each
+// hap is seen twice, once from each of its other two tiles.
+static void updateLinesThrough(GameState *game, int position, bool onBoard) {
+    TileId tile = game->tiles[position];
+    for (int p = 0; p < NUM_TILES; p++) {
+        TileId other = game->tiles[p];
+        if (p == position || !((game->board >> THIRD_TILE[tile][other]) & 1)) {
+            continue;
+        }
+        int line = HAP_LINE_OF[tile][other];
+        if (onBoard) {
+            setLine(game->boardLines, line);
+        } else {
+            clearLine(game->boardLines, line);
+            clearLine(game->foundLines, line);
+        }
+    }
+}
+
+static void updateHapCounts(GameState *game) {
+    game->numHaps = countLines(game->boardLines);
+    game->remainingHaps = game->numHaps - countLines(game->foundLines);
+}
+
+// A round starts with nothing selected or found
+void startRound(GameState *game, const TileId *boardTiles) {
+    for (int i = 0; i < NUM_TILES; i++) {
+        game->tiles[i] = boardTiles[i];
+    }
+    game->board = boardToMask(boardTiles, NUM_TILES);
+    game->boardLines[0] = 0;
+    game->boardLines[1] = 0;
+    for (int i = 0; i < NUM_TILES; i++) {
+        updateLinesThrough(game, i, true);
+    }
+    game->foundLines[0] = 0;
+    game->foundLines[1] = 0;
+    game->selection = 0;
+    game->score = 0;
+    game->isGameOver = false;
+    updateHapCounts(game);
+}
+
+// Swaps the tile at position for one not on the board, updating only the
+// haps through that position. Found haps that lose a tile are forgotten, so
+// a hap put back together later counts again. False if tile is already on
+// the board.
+bool replaceTile(GameState *game, int position, TileId tile) {
+    if ((game->board >> tile) & 1) {
+        return false;
+    }
+    updateLinesThrough(game, position, false);
+    game->board = (game->board & ~(1u << game->tiles[position])) | 1u << tile;
+    game->tiles[position] = tile;
+    updateLinesThrough(game, position, true);
+
+    game->selection &= (SelectionMask)~(1u << position);
+    updateHapCounts(game);
+    return true;
+}
+
+// Positions of the first hap not found yet, false if there is none
+bool findHint(const GameState *game, uint8_t *hintPositions) {
+    int line = -1;
+    for (int w = 0; w < 2 && line < 0; w++) {
+        uint64_t unfound = game->boardLines[w] & ~game->foundLines[w];
+        if (unfound != 0) {
+            line = w * 64 + __builtin_ctzll(unfound);
+        }
+    }
+    if (line < 0) {
+        return false;
+    }
+
+    int found = 0;
+    for (int i = 0; i < NUM_TILES; i++) {
+        if ((HAP_LINES[line] >> game->tiles[i]) & 1) {
+            hintPositions[found++] = (uint8_t)i;
+        }
+    }
+    return true;
+}
+
+bool isPositionSelected(const GameState *game, int position) {
+    return (game->selection >> position) & 1;
+}
+
+// Clicking a selected tile deselects it, otherwise it is added if there is
+// room. The third tile submits the selection.
+SubmitResult togglePosition(GameState *game, int position) {
+    SelectionMask bit = (SelectionMask)(1u << position);
+    if (game->selection & bit) {
+        game->selection &= (SelectionMask)~bit;
+        return SUBMIT_NONE;
+    }
+    if (__builtin_popcount(game->selection) >= MAX_SELECTED_TILES) {
+        return SUBMIT_NONE;
+    }
+    game->selection |= bit;
+    return submitSelection(game);
+}
+
+// Scores the selection once 3 tiles are picked, then clears it. All three
+// tiles are on the board, so the triple is one of its haps exactly when
+// the third tile completes the first two, and the line through them is
+// its slot in foundLines.
+SubmitResult submitSelection(GameState *game) {
+    if (__builtin_popcount(game->selection) != MAX_SELECTED_TILES) {
+        return SUBMIT_NONE;
+    }
+
+    unsigned int bits = game->selection;
+    TileId a = game->tiles[__builtin_ctz(bits)];
+    bits &= bits - 1;
+    TileId b = game->tiles[__builtin_ctz(bits)];
+    bits &= bits - 1;
+    TileId c = game->tiles[__builtin_ctz(bits)];
+    game->selection = 0; // Reset selection
+
+    if (THIRD_TILE[a][b] != c) {
+        game->score--; // Wrong Answer
+        return SUBMIT_WRONG;
+    }
+
+    int line = HAP_LINE_OF[a][b];
+    if ((game->foundLines[line >> 6] >> (line & 63)) & 1) {
+        game->score--; // Duplicate Answer
+        return SUBMIT_DUPLICATE;
+    }
+    setLine(game->foundLines, line);
+    game->remainingHaps--;
+    game->score++; // Right Answer
+    return SUBMIT_HAP;
+}
+
+bool isValidGyul(int remainingHaps) {
+    return remainingHaps == 0;
+}
+
+void claimGyul(GameState *game) {
+    if (isValidGyul(game->remainingHaps)) {
+        game->score += 3;
+        game->isGameOver = true;
+    } else {
+        game->score -= 1;
+    }
+}
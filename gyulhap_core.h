@@ -0,0 +1,95 @@
+#ifndef GYULHAP_CORE_H
+#define GYULHAP_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Rules of the game, without any raylib dependency
+#define NUM_TILES 9
+#define TOTAL_COMBINATIONS 27
+#define MAX_SELECTED_TILES 3
+#define MAX_HAPS 84 // C(9, 3), every triple on the board
+#define NUM_LINES 117 // Lines of AG(3, 3), every possible hap
+#define NUM_BOARDS 4686825 // C(27, 9), every possible board
+
+typedef enum { BG_WHITE, BG_GREY, BG_BLACK } BackgroundColor;
+typedef enum { S_CIRCLE, S_SQUARE, S_TRIANGLE } Shape;
+typedef enum { C_RED, C_YELLOW, C_BLUE } ShapeColor;
+
+typedef struct {
+    BackgroundColor backgroundColor;
+    Shape shape;
+    ShapeColor shapeColor;
+} Tile;
+
+// Packed tile, backgroundColor * 9 + shape * 3 + shapeColor (0 to 26)
+typedef uint8_t TileId;
+
+// THIRD_TILE[a][b] is the only tile that makes a hap with a and b:
+// every attribute is the negated sum of the other two, mod 3
+extern const TileId THIRD_TILE[TOTAL_COMBINATIONS][TOTAL_COMBINATIONS];
+
+// Three tiles in one word, for batch validation: a | b << 8 | c << 16
+#define PACK_TRIPLE(a, b, c) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16)
+
+// Board as a set of tiles, bit t set when TileId t is on the board
+typedef uint32_t BoardMask;
+
+// The 117 haps as 3-bit masks, ordered by their tiles
+extern const BoardMask HAP_LINES[NUM_LINES];
+
+// HAP_LINE_OF[a][b] is the HAP_LINES index through tiles a and b (NO_LINE if a == b)
+#define NO_LINE 255
+extern const uint8_t HAP_LINE_OF[TOTAL_COMBINATIONS][TOTAL_COMBINATIONS];
+
+// Board positions 0 to NUM_TILES - 1, bit i set when position i is selected
+typedef uint16_t SelectionMask;
+
+typedef enum { SUBMIT_NONE, SUBMIT_HAP, SUBMIT_DUPLICATE, SUBMIT_WRONG } SubmitResult;
+
+// Everything a round needs, fixed size so it lives on the stack. The haps
+// on the board and the found haps are bitsets over the HAP_LINES indices,
+// kept up to date as tiles are replaced.
+typedef struct {
+    TileId tiles[NUM_TILES]; // On-screen order
+    BoardMask board;
+    SelectionMask selection;
+    uint64_t boardLines[2];
+    uint64_t foundLines[2]; // Always a subset of boardLines
+    int numHaps;
+    int remainingHaps;
+    int score;
+    bool isGameOver;
+} GameState;
+
+bool areAllSameOrAllDifferent(int value1, int value2, int value3);
+bool compareTiles(Tile *tiles1, Tile *tiles2);
+bool isValidHap(Tile tile1, Tile tile2, Tile tile3);
+TileId tileToId(Tile tile);
+Tile tileFromId(TileId id);
+bool isValidHapPacked(TileId tile1, TileId tile2, TileId tile3);
+int countHapsPacked(const TileId *boardTiles, int numTiles);
+int findHapsPacked(const TileId *boardTiles, int numTiles, uint8_t (*hapPositions)[3]);
+BoardMask boardToMask(const TileId *boardTiles, int numTiles);
+bool isBoardMask(BoardMask board);
+int countHapsMask(BoardMask board);
+void countHapsMaskBatch(const BoardMask *boards, uint8_t *counts, int numBoards);
+void validateHapsBatch(const uint32_t *triples, uint8_t *valid, int numTriples);
+int maskToTiles(BoardMask board, TileId *boardTiles);
+uint32_t rankBoard(BoardMask board);
+BoardMask unrankBoard(uint32_t rank);
+BoardMask nextBoard(BoardMask board);
+int countAllHaps(Tile *boardTiles, int numTiles);
+void findAllHaps(Tile *boardTiles, int numTiles, Tile (*haps)[3]);
+void initTileDeck(Tile *tilesArray);
+void shuffleArray(Tile *array, int size);
+void startRound(GameState *game, const TileId *boardTiles);
+bool replaceTile(GameState *game, int position, TileId tile);
+bool findHint(const GameState *game, uint8_t *hintPositions);
+bool isPositionSelected(const GameState *game, int position);
+SubmitResult togglePosition(GameState *game, int position);
+SubmitResult submitSelection(GameState *game);
+bool isValidGyul(int remainingHaps);
+void claimGyul(GameState *game);
+
+#endif
@@ -0,0 +1,104 @@
+#include "gyulhap_engine.h"
+#include <stddef.h>
+
+#define POW3_3 27
+#define POW3_4 81
+#define VARIANT_TILES(k) POW3_##k
+
+// COMPLETION_k[a][b]: the tile finishing a hap with a and b, per attribute
+// the negated sum mod 3 (COMPLETION_3 matches THIRD_TILE)
+static uint8_t COMPLETION_3[POW3_3][POW3_3];
+static uint8_t COMPLETION_4[POW3_4][POW3_4];
+
+static void buildCompletion(uint8_t *table, int attributes) {
+    int numTiles = 1;
+    for (int i = 0; i < attributes; i++) {
+        numTiles *= 3;
+    }
+
+    for (int a = 0; a < numTiles; a++) {
+        for (int b = 0; b < numTiles; b++) {
+            int third = 0;
+            for (int place = numTiles / 3; place > 0; place /= 3) {
+                int digitA = (a / place) % 3;
+                int digitB = (b / place) % 3;
+                third += ((6 - digitA - digitB) % 3) * place;
+            }
+            table[a * numTiles + b] = (uint8_t)third;
+        }
+    }
+}
+
+__attribute__((constructor))
+static void initCompletionTables(void) {
+    buildCompletion(&COMPLETION_3[0][0], 3);
+    buildCompletion(&COMPLETION_4[0][0], 4);
+}
+
+// Same scheme as countHapsPacked / findHapsPacked: every pair has one
+// completing tile, counted once per pair of the hap, or recorded from the
+// hap's first two positions
+#define DEFINE_VARIANT_KERNELS(k, n)                                                  \
+    static int countHaps_##k##_##n(const TileId *boardTiles) {                        \
+        uint8_t present[VARIANT_TILES(k)] = {0};                                      \
+        int numPairs = 0;                                                             \
+        for (int i = 0; i < (n); i++) {                                               \
+            present[boardTiles[i]] = 1;                                               \
+        }                                                                             \
+        _Pragma("GCC unroll 16")                                                      \
+        for (int i = 0; i < (n) - 1; i++) {                                           \
+            const uint8_t *thirds = COMPLETION_##k[boardTiles[i]];                    \
+            _Pragma("GCC unroll 16")                                                  \
+            for (int j = i + 1; j < (n); j++) {                                       \
+                numPairs += present[thirds[boardTiles[j]]];                           \
+            }                                                                         \
+        }                                                                             \
+        return numPairs / 3;                                                          \
+    }                                                                                 \
+                                                                                      \
+    static int findHaps_##k##_##n(const TileId *boardTiles, uint8_t (*hapPositions)[3]) { \
+        int8_t position[VARIANT_TILES(k)];                                            \
+        int numHaps = 0;                                                              \
+        for (int t = 0; t < VARIANT_TILES(k); t++) {                                  \
+            position[t] = -1;                                                         \
+        }                                                                             \
+        for (int i = 0; i < (n); i++) {                                               \
+            position[boardTiles[i]] = (int8_t)i;                                      \
+        }                                                                             \
+        for (int i = 0; i < (n) - 2; i++) {                                           \
+            const uint8_t *thirds = COMPLETION_##k[boardTiles[i]];                    \
+            for (int j = i + 1; j < (n) - 1; j++) {                                   \
+                int m = position[thirds[boardTiles[j]]];                              \
+                if (m > j) {                                                          \
+                    hapPositions[numHaps][0] = (uint8_t)i;                            \
+                    hapPositions[numHaps][1] = (uint8_t)j;                            \
+                    hapPositions[numHaps][2] = (uint8_t)m;                            \
+                    numHaps++;                                                        \
+                }                                                                     \
+            }                                                                         \
+        }                                                                             \
+        return numHaps;                                                               \
+    }
+
+GYUL_VARIANTS(DEFINE_VARIANT_KERNELS)
+
+#define VARIANT_ENTRY(k, n) {(k), (n), VARIANT_TILES(k), countHaps_##k##_##n, findHaps_##k##_##n},
+
+const GyulVariant GYUL_VARIANT_TABLE[] = {
+    GYUL_VARIANTS(VARIANT_ENTRY)
+};
+
+const int NUM_VARIANTS = sizeof(GYUL_VARIANT_TABLE) / sizeof(GYUL_VARIANT_TABLE[0]);
+
+const GyulVariant *findVariant(int attributes, int boardSize) {
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        if (GYUL_VARIANT_TABLE[v].attributes == attributes && GYUL_VARIANT_TABLE[v].boardSize == boardSize) {
+            return &GYUL_VARIANT_TABLE[v];
+        }
+    }
+    return NULL;
+}
+
+TileId completeHapVariant(int attributes, TileId tile1, TileId tile2) {
+    return attributes == 4 ? COMPLETION_4[tile1][tile2] : COMPLETION_3[tile1][tile2];
+}
@@ -0,0 +1,39 @@
+#ifndef GYULHAP_ENGINE_H
+#define GYULHAP_ENGINE_H
+
+#include "gyulhap_core.h"
+
+// Rules for other game sizes: k attributes (3^k distinct tiles) and any
+// board size. Each (attributes, board size) pair listed in GYUL_VARIANTS
+// gets its own kernels with both sizes fixed at compile time, so the pair
+// loops are fully unrolled over that variant's completion table.
+
+#define MAX_ATTRIBUTES 4
+#define MAX_VARIANT_TILES 81   // 3^MAX_ATTRIBUTES
+#define MAX_BOARD_SIZE 16
+#define MAX_VARIANT_HAPS 40    // Each pair is on one hap: C(16, 2) / 3
+
+// X(attributes, boardSize)
+#define GYUL_VARIANTS(X) \
+    X(3, 9)              \
+    X(3, 12)             \
+    X(3, 16)             \
+    X(4, 9)              \
+    X(4, 12)             \
+    X(4, 16)
+
+typedef struct {
+    int attributes;
+    int boardSize;
+    int numTiles; // 3^attributes
+    int (*countHaps)(const TileId *boardTiles);
+    int (*findHaps)(const TileId *boardTiles, uint8_t (*hapPositions)[3]);
+} GyulVariant;
+
+extern const GyulVariant GYUL_VARIANT_TABLE[];
+extern const int NUM_VARIANTS;
+
+const GyulVariant *findVariant(int attributes, int boardSize);
+TileId completeHapVariant(int attributes, TileId tile1, TileId tile2);
+
+#endif
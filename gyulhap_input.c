@@ -0,0 +1,44 @@
+#include "gyulhap_input.h"
+
+void initInputQueue(InputQueue *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->dropped = 0;
+}
+
+// A full queue keeps the older events and counts the new one as dropped
+bool pushInputEvent(InputQueue *queue, InputEvent event) {
+    if (queue->tail - queue->head == INPUT_QUEUE_SIZE) {
+        queue->dropped++;
+        return false;
+    }
+    queue->events[queue->tail++ & (INPUT_QUEUE_SIZE - 1)] = event;
+    return true;
+}
+
+bool popInputEvent(InputQueue *queue, InputEvent *event) {
+    if (queue->head == queue->tail) {
+        return false;
+    }
+    *event = queue->events[queue->head++ & (INPUT_QUEUE_SIZE - 1)];
+    return true;
+}
+
+// Index (row-major) of the tile under (x, y), or -1 for the gaps and outside.
+// Tile edges count as inside.
+int gridHitTest(const GridLayout *grid, float x, float y) {
+    float dx = x - grid->x;
+    float dy = y - grid->y;
+    if (dx < 0 || dy < 0) {
+        return -1;
+    }
+
+    int pitch = grid->tileSize + grid->spacing;
+    int column = (int)dx / pitch;
+    int row = (int)dy / pitch;
+    if (column >= grid->columns || row >= grid->rows ||
+        dx - column * pitch > grid->tileSize || dy - row * pitch > grid->tileSize) {
+        return -1;
+    }
+    return row * grid->columns + column;
+}
@@ -0,0 +1,44 @@
+#ifndef GYULHAP_INPUT_H
+#define GYULHAP_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pointer events queued in arrival order with their timestamps, so a frame
+// handles every press it collected instead of one edge per poll, and the
+// tile under a point is found by grid arithmetic rather than a scan.
+
+#define INPUT_QUEUE_SIZE 64 // Power of two
+
+typedef enum { POINTER_DOWN, POINTER_UP } InputEventType;
+
+typedef struct {
+    InputEventType type;
+    float x;
+    float y;
+    uint64_t time; // Monotonic nanoseconds
+} InputEvent;
+
+typedef struct {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    uint32_t head; // Next to pop
+    uint32_t tail; // Next to push
+    uint32_t dropped; // Pushed while full
+} InputQueue;
+
+// Tiles in a grid of columns x rows, tileSize apart by spacing
+typedef struct {
+    int x;
+    int y;
+    int tileSize;
+    int spacing;
+    int columns;
+    int rows;
+} GridLayout;
+
+void initInputQueue(InputQueue *queue);
+bool pushInputEvent(InputQueue *queue, InputEvent event);
+bool popInputEvent(InputQueue *queue, InputEvent *event);
+int gridHitTest(const GridLayout *grid, float x, float y);
+
+#endif
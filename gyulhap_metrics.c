@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_metrics.h"
+#include <stdio.h>
+#include <time.h>
+
+#define SUB_BUCKETS (1u << HISTOGRAM_SUB_BITS)
+
+const char *METRIC_NAMES[NUM_METRICS] = {"update", "draw", "frame", "input-to-feedback"};
+
+uint64_t monotonicNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Values below SUB_BUCKETS get a bucket each, above that every power of two
+// is split into SUB_BUCKETS equal steps
+static int bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (int)value;
+    }
+    int magnitude = 63 - __builtin_clzll(value);
+    if (magnitude >= HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BITS) + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Largest value that lands in a bucket
+static uint64_t bucketLimit(int bucket) {
+    if (bucket < (int)SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t base = (uint64_t)(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift;
+    return base + (1ULL << shift) - 1;
+}
+
+void resetHistogram(LatencyHistogram *histogram) {
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        histogram->counts[b] = 0;
+    }
+    histogram->total = 0;
+    histogram->min = UINT64_MAX;
+    histogram->max = 0;
+    histogram->sum = 0;
+}
+
+void recordLatency(LatencyHistogram *histogram, uint64_t nanos) {
+    histogram->counts[bucketOf(nanos)]++;
+    histogram->total++;
+    histogram->sum += (double)nanos;
+    if (nanos < histogram->min) {
+        histogram->min = nanos;
+    }
+    if (nanos > histogram->max) {
+        histogram->max = nanos;
+    }
+}
+
+// Upper bound of the bucket holding the given percentile (0 to 100),
+// clamped to the largest value seen
+uint64_t histogramPercentile(const LatencyHistogram *histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen >= rank) {
+            uint64_t limit = bucketLimit(b);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void resetFrameMetrics(FrameMetrics *metrics) {
+    for (int m = 0; m < NUM_METRICS; m++) {
+        resetHistogram(&metrics->histograms[m]);
+    }
+}
+
+// One line of microseconds: count, mean, p50, p90, p99, p99.9, max
+int formatHistogram(char *out, size_t size, const char *name, const LatencyHistogram *histogram) {
+    if (histogram->total == 0) {
+        return snprintf(out, size, "%-18s n=0", name);
+    }
+    return snprintf(out, size, "%-18s n=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f us",
+                    name, (unsigned long long)histogram->total, histogram->sum / histogram->total / 1e3,
+                    histogramPercentile(histogram, 50) / 1e3, histogramPercentile(histogram, 90) / 1e3,
+                    histogramPercentile(histogram, 99) / 1e3, histogramPercentile(histogram, 99.9) / 1e3,
+                    histogram->max / 1e3);
+}
+
+// Rewrites path with the totals so far, replacing it only once complete
+bool exportFrameMetrics(const FrameMetrics *metrics, const char *path) {
+    char tmpPath[4096];
+    char line[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *file = fopen(tmpPath, "w");
+    if (file == NULL) {
+        return false;
+    }
+    for (int m = 0; m < NUM_METRICS; m++) {
+        formatHistogram(line, sizeof(line), METRIC_NAMES[m], &metrics->histograms[m]);
+        fprintf(file, "%s\n", line);
+    }
+    bool ok = fclose(file) == 0 && rename(tmpPath, path) == 0;
+    if (!ok) {
+        remove(tmpPath);
+    }
+    return ok;
+}
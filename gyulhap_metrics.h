@@ -0,0 +1,43 @@
+#ifndef GYULHAP_METRICS_H
+#define GYULHAP_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// HDR-style latency histograms: log-linear buckets, 2^HISTOGRAM_SUB_BITS
+// per power of two, so any recorded value is reported within about 3% from
+// 1ns up to HISTOGRAM_MAX_BITS. Fixed size and no allocation, recording is a
+// couple of shifts and an increment.
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_MAX_BITS 40 // About 18 minutes in nanoseconds
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+#define METRICS_PATH "gyulhap-metrics.txt"
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} LatencyHistogram;
+
+// What the GUI loop measures, all in nanoseconds
+typedef enum { METRIC_UPDATE, METRIC_DRAW, METRIC_FRAME, METRIC_INPUT_LATENCY, NUM_METRICS } Metric;
+
+typedef struct {
+    LatencyHistogram histograms[NUM_METRICS];
+} FrameMetrics;
+
+extern const char *METRIC_NAMES[NUM_METRICS];
+
+uint64_t monotonicNanos(void);
+void resetHistogram(LatencyHistogram *histogram);
+void recordLatency(LatencyHistogram *histogram, uint64_t nanos);
+uint64_t histogramPercentile(const LatencyHistogram *histogram, double percentile);
+void resetFrameMetrics(FrameMetrics *metrics);
+int formatHistogram(char *out, size_t size, const char *name, const LatencyHistogram *histogram);
+bool exportFrameMetrics(const FrameMetrics *metrics, const char *path);
+
+#endif
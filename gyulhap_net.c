@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_net.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define LISTEN_BACKLOG 1024
+
+// "host:port" for TCP (IPv4), "unix:path" for a Unix socket
+static bool parseAddress(const char *address, struct sockaddr_storage *storage, socklen_t *length) {
+    memset(storage, 0, sizeof(*storage));
+
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un *unixAddress = (struct sockaddr_un *)storage;
+        if (strlen(address + 5) >= sizeof(unixAddress->sun_path)) {
+            return false;
+        }
+        unixAddress->sun_family = AF_UNIX;
+        strcpy(unixAddress->sun_path, address + 5);
+        *length = sizeof(*unixAddress);
+        return true;
+    }
+
+    char host[64];
+    const char *colon = strrchr(address, ':');
+    if (colon == NULL || (size_t)(colon - address) >= sizeof(host)) {
+        return false;
+    }
+    memcpy(host, address, (size_t)(colon - address));
+    host[colon - address] = '\0';
+
+    struct sockaddr_in *inetAddress = (struct sockaddr_in *)storage;
+    inetAddress->sin_family = AF_INET;
+    inetAddress->sin_port = htons((uint16_t)atoi(colon + 1));
+    if (inet_pton(AF_INET, host, &inetAddress->sin_addr) != 1) {
+        return false;
+    }
+    *length = sizeof(*inetAddress);
+    return true;
+}
+
+// Size of a spectator frame from its type byte, 0 if it isn't one
+int netFrameSize(uint8_t type) {
+    switch (type) {
+        case NET_SNAPSHOT:
+            return sizeof(NetSnapshot);
+        case NET_DELTA_HAP:
+        case NET_DELTA_WRONG:
+        case NET_DELTA_DUPLICATE:
+        case NET_DELTA_GYUL_WON:
+        case NET_DELTA_GYUL_WRONG:
+            return sizeof(NetDelta);
+        default:
+            return 0;
+    }
+}
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Thousands of sockets in one process need more than the usual soft limit
+void raiseFileLimit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Non-blocking listening socket, -1 with errno set on failure. A stale Unix
+// socket file is replaced.
+int listenOn(const char *address) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    if (!parseAddress(address, &storage, &length)) {
+        fprintf(stderr, "bad address %s\n", address);
+        return -1;
+    }
+
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (storage.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&storage)->sun_path);
+    } else {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(fd, (struct sockaddr *)&storage, length) != 0 || listen(fd, LISTEN_BACKLOG) != 0 || !setNonBlocking(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Blocking connection with Nagle off, -1 with errno set on failure
+int connectTo(const char *address) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    if (!parseAddress(address, &storage, &length)) {
+        fprintf(stderr, "bad address %s\n", address);
+        return -1;
+    }
+
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&storage, length) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (storage.ss_family == AF_INET) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
@@ -0,0 +1,89 @@
+#ifndef GYULHAP_NET_H
+#define GYULHAP_NET_H
+
+#include "gyulhap_core.h"
+
+// Wire protocol between gyulhap-server and its players. Every message is
+// one fixed-size NetMessage in native endian, both ways, so a reader only
+// ever waits for 16 bytes.
+//
+// Client to server:
+//   NET_JOIN   value = room number
+//   NET_CLAIM  positions = three board positions, value = game number of
+//              the round it is for
+//   NET_GYUL   value = game number of the round it is for
+// Server to client:
+//   NET_ROUND  a round starts (or is joined): value = game number, the
+//              board is boardFromSeed/seededBoardTiles of it; player = your
+//              slot, remainingHaps = haps left
+//   NET_RESULT player's claim or GYUL was scored: result = SubmitResult, or
+//              NET_GYUL_WON / NET_GYUL_WRONG for a GYUL; sent to the whole
+//              room, value = the round's game number
+//   NET_ERROR  result = NetError, value = the offending message's value;
+//              NET_ERROR_STALE for a claim or GYUL whose round is over,
+//              which is not scored
+//
+// Spectators send one NET_WATCH (value = room) and from then on only
+// receive a byte stream of frames, each starting with its type byte:
+//   NetSnapshot  the whole room, on watching, on every new round, and in
+//                place of anything a spectator fell too far behind on
+//   NetDelta     one scored claim or GYUL against the last snapshot
+
+#define NET_DEFAULT_ADDRESS "127.0.0.1:7878"
+#define NET_MAX_PLAYERS 8
+
+typedef enum {
+    NET_JOIN = 1,
+    NET_CLAIM,
+    NET_GYUL,
+    NET_ROUND,
+    NET_RESULT,
+    NET_ERROR,
+    NET_WATCH,
+    NET_SNAPSHOT,
+    NET_DELTA_HAP,
+    NET_DELTA_WRONG,
+    NET_DELTA_DUPLICATE,
+    NET_DELTA_GYUL_WON,
+    NET_DELTA_GYUL_WRONG
+} NetType;
+typedef enum { NET_GYUL_WON = 16, NET_GYUL_WRONG } NetGyulResult;
+typedef enum { NET_ERROR_ROOM = 1, NET_ERROR_FULL, NET_ERROR_NOT_JOINED, NET_ERROR_POSITIONS, NET_ERROR_STALE } NetError;
+
+typedef struct {
+    uint8_t type;
+    uint8_t player;
+    uint8_t result;
+    int8_t scoreDelta;
+    uint8_t positions[3];
+    uint8_t remainingHaps;
+    uint64_t value;
+} NetMessage;
+
+// A hap won, a missed claim or a GYUL, 4 bytes
+typedef struct {
+    uint8_t type;
+    int8_t scoreDelta;
+    uint16_t data; // Player << 12 | HAP_LINES index (NET_DELTA_HAP) or the claimed SelectionMask (misses)
+} NetDelta;
+
+#define NET_DELTA_PLAYER(data) ((data) >> 12)
+#define NET_DELTA_VALUE(data) ((data) & 0xFFF)
+
+typedef struct {
+    uint8_t type;
+    uint8_t remainingHaps;
+    uint16_t players; // Bit p set when slot p is taken
+    uint32_t reserved;
+    uint64_t gameNumber; // Board as in NET_ROUND
+    uint64_t foundLines[2];
+    int16_t scores[NET_MAX_PLAYERS]; // This round's, by slot
+} NetSnapshot;
+
+int netFrameSize(uint8_t type);
+int listenOn(const char *address);
+int connectTo(const char *address);
+bool setNonBlocking(int fd);
+void raiseFileLimit(void);
+
+#endif
@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+
+// One slice per worker, padded to its own cache line
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t next;
+    uint64_t end;
+    char padding[64];
+} WorkSlice;
+
+typedef struct {
+    WorkSlice *slices;
+    int numThreads;
+    uint64_t grain;
+    WorkFn work;
+    void *context;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int worker;
+} WorkerArgs;
+
+int defaultThreadCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+    return count > MAX_THREADS ? MAX_THREADS : (int)count;
+}
+
+static bool takeChunk(WorkSlice *slice, uint64_t grain, uint64_t *begin, uint64_t *end) {
+    bool found = false;
+    pthread_mutex_lock(&slice->lock);
+    if (slice->next < slice->end) {
+        *begin = slice->next;
+        *end = slice->end - slice->next > grain ? slice->next + grain : slice->end;
+        slice->next = *end;
+        found = true;
+    }
+    pthread_mutex_unlock(&slice->lock);
+    return found;
+}
+
+// Moves the back half of victim's slice into the (empty) thief slice
+static bool stealHalf(WorkSlice *victim, WorkSlice *thief) {
+    uint64_t begin = 0, end = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->next < victim->end) {
+        uint64_t remaining = victim->end - victim->next;
+        begin = victim->next + remaining / 2;
+        end = victim->end;
+        victim->end = begin;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (begin == end) {
+        return false;
+    }
+    pthread_mutex_lock(&thief->lock);
+    thief->next = begin;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->lock);
+    return true;
+}
+
+static void *runWorker(void *arg) {
+    WorkerArgs *args = arg;
+    Pool *pool = args->pool;
+    WorkSlice *mine = &pool->slices[args->worker];
+
+    for (;;) {
+        uint64_t begin, end;
+        if (takeChunk(mine, pool->grain, &begin, &end)) {
+            pool->work(pool->context, args->worker, begin, end);
+            continue;
+        }
+
+        // Out of work: one pass over the others, starting with the next worker
+        bool stole = false;
+        for (int i = 1; i < pool->numThreads && !stole; i++) {
+            stole = stealHalf(&pool->slices[(args->worker + i) % pool->numThreads], mine);
+        }
+        if (!stole) {
+            return NULL;
+        }
+    }
+}
+
+bool parallelFor(uint64_t count, uint64_t grain, int numThreads, WorkFn work, void *context) {
+    if (numThreads < 1) {
+        numThreads = defaultThreadCount();
+    }
+    if (numThreads > MAX_THREADS) {
+        numThreads = MAX_THREADS;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    Pool pool = {NULL, numThreads, grain, work, context};
+    pthread_t threads[MAX_THREADS];
+    WorkerArgs args[MAX_THREADS];
+
+    pool.slices = calloc((size_t)numThreads, sizeof(WorkSlice));
+    if (pool.slices == NULL) {
+        return false;
+    }
+    for (int w = 0; w < numThreads; w++) {
+        pthread_mutex_init(&pool.slices[w].lock, NULL);
+        pool.slices[w].next = count * w / numThreads;
+        pool.slices[w].end = count * (w + 1) / numThreads;
+        args[w].pool = &pool;
+        args[w].worker = w;
+    }
+
+    // The calling thread is worker 0
+    int started = 1;
+    for (; started < numThreads; started++) {
+        if (pthread_create(&threads[started], NULL, runWorker, &args[started]) != 0) {
+            break;
+        }
+    }
+    runWorker(&args[0]);
+    for (int w = 1; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    // Slices of threads that failed to start are picked up here
+    for (int w = started; w < numThreads; w++) {
+        uint64_t begin, end;
+        while (takeChunk(&pool.slices[w], grain, &begin, &end)) {
+            work(context, 0, begin, end);
+        }
+    }
+
+    for (int w = 0; w < numThreads; w++) {
+        pthread_mutex_destroy(&pool.slices[w].lock);
+    }
+    free(pool.slices);
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef GYULHAP_POOL_H
+#define GYULHAP_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Work-stealing parallel for over [0, count). Every worker starts with an
+// equal slice and takes grain-sized chunks from its front. An idle worker
+// steals the back half of another worker's slice, so uneven chunks still
+// keep every core busy.
+
+typedef void (*WorkFn)(void *context, int worker, uint64_t begin, uint64_t end);
+
+int defaultThreadCount(void);
+bool parallelFor(uint64_t count, uint64_t grain, int numThreads, WorkFn work, void *context);
+
+#endif
@@ -0,0 +1,121 @@
+#include "gyulhap_prefetch.h"
+#include "gyulhap_seed.h"
+
+static void prepareRound(RoundPrefetch *prefetch, int targetHaps, uint64_t *nextGame, PreparedRound *round) {
+    uint32_t count = catalogCount(prefetch->catalog, targetHaps);
+    BoardMask board;
+
+    for (int attempt = 0; ; attempt++) {
+        int symmetry;
+
+        round->gameNumber = (*nextGame)++;
+        if (count > 0) {
+            board = catalogBoard(prefetch->catalog, targetHaps, seededIndex(round->gameNumber, count));
+        } else {
+            board = boardFromSeed(round->gameNumber);
+        }
+        const CachedSolution *solution = solveCached(&prefetch->dealtBoards, board, &symmetry);
+
+        if (solution->timesSeen == 1 || attempt == MAX_REDEALS) {
+            break;
+        }
+    }
+
+    round->targetHaps = targetHaps;
+    round->board = board;
+    seededBoardTiles(board, round->gameNumber, round->tiles);
+}
+
+// Keeps the queue full. Rounds are dealt outside the lock and dropped if
+// the difficulty changed meanwhile, their game numbers used up all the same.
+static void *runProducer(void *arg) {
+    RoundPrefetch *prefetch = arg;
+
+    pthread_mutex_lock(&prefetch->lock);
+    for (;;) {
+        while (!prefetch->stopping && prefetch->count == PREFETCH_ROUNDS) {
+            pthread_cond_wait(&prefetch->changed, &prefetch->lock);
+        }
+        if (prefetch->stopping) {
+            break;
+        }
+        int targetHaps = prefetch->targetHaps;
+        uint64_t generation = prefetch->generation;
+        uint64_t nextGame = prefetch->nextGame;
+        pthread_mutex_unlock(&prefetch->lock);
+
+        PreparedRound round;
+        prepareRound(prefetch, targetHaps, &nextGame, &round);
+
+        pthread_mutex_lock(&prefetch->lock);
+        if (prefetch->generation == generation) {
+            prefetch->rounds[(prefetch->head + prefetch->count) % PREFETCH_ROUNDS] = round;
+            prefetch->count++;
+            pthread_cond_broadcast(&prefetch->changed);
+        }
+        prefetch->nextGame = nextGame;
+    }
+    pthread_mutex_unlock(&prefetch->lock);
+    return NULL;
+}
+
+bool startRoundPrefetch(RoundPrefetch *prefetch, const BoardCatalog *catalog, uint64_t firstGame, int targetHaps) {
+    prefetch->head = 0;
+    prefetch->count = 0;
+    prefetch->targetHaps = targetHaps;
+    prefetch->generation = 0;
+    prefetch->nextGame = firstGame;
+    prefetch->stopping = false;
+    prefetch->catalog = catalog;
+    if (!initSolutionCache(&prefetch->dealtBoards, 1 << 12)) {
+        return false;
+    }
+    pthread_mutex_init(&prefetch->lock, NULL);
+    pthread_cond_init(&prefetch->changed, NULL);
+
+    prefetch->threaded = pthread_create(&prefetch->producer, NULL, runProducer, prefetch) == 0;
+    return true;
+}
+
+// Takes the oldest round, only waiting for the producer right after a start
+// or a difficulty change
+void popPreparedRound(RoundPrefetch *prefetch, PreparedRound *round) {
+    if (!prefetch->threaded) {
+        prepareRound(prefetch, prefetch->targetHaps, &prefetch->nextGame, round);
+        return;
+    }
+    pthread_mutex_lock(&prefetch->lock);
+    while (prefetch->count == 0) {
+        pthread_cond_wait(&prefetch->changed, &prefetch->lock);
+    }
+    *round = prefetch->rounds[prefetch->head];
+    prefetch->head = (prefetch->head + 1) % PREFETCH_ROUNDS;
+    prefetch->count--;
+    pthread_cond_broadcast(&prefetch->changed);
+    pthread_mutex_unlock(&prefetch->lock);
+}
+
+void setPrefetchTarget(RoundPrefetch *prefetch, int targetHaps) {
+    pthread_mutex_lock(&prefetch->lock);
+    if (prefetch->targetHaps != targetHaps) {
+        prefetch->targetHaps = targetHaps;
+        prefetch->generation++;
+        prefetch->count = 0;
+        pthread_cond_broadcast(&prefetch->changed);
+    }
+    pthread_mutex_unlock(&prefetch->lock);
+}
+
+void stopRoundPrefetch(RoundPrefetch *prefetch) {
+    pthread_mutex_lock(&prefetch->lock);
+    prefetch->stopping = true;
+    pthread_cond_broadcast(&prefetch->changed);
+    pthread_mutex_unlock(&prefetch->lock);
+    if (prefetch->threaded) {
+        pthread_join(prefetch->producer, NULL);
+    }
+
+    pthread_cond_destroy(&prefetch->changed);
+    pthread_mutex_destroy(&prefetch->lock);
+    freeSolutionCache(&prefetch->dealtBoards);
+}
@@ -0,0 +1,49 @@
+#ifndef GYULHAP_PREFETCH_H
+#define GYULHAP_PREFETCH_H
+
+#include "gyulhap_core.h"
+#include "gyulhap_catalog.h"
+#include "gyulhap_canon.h"
+#include <pthread.h>
+
+// Rounds dealt ahead of time by a producer thread, so starting a round only
+// pops a queue. Game #N is always the same board: boardFromSeed(N), or with
+// a difficulty set the seeded pick from that catalogue group. A board
+// equivalent to one already dealt this session is skipped for the next game
+// number.
+//
+// Changing the difficulty drops the queued rounds. Their game numbers are
+// not reused and their boards still count as dealt.
+
+#define PREFETCH_ROUNDS 4
+#define MAX_REDEALS 8
+
+typedef struct {
+    uint64_t gameNumber;
+    int targetHaps;
+    BoardMask board;
+    TileId tiles[NUM_TILES]; // On-screen order
+} PreparedRound;
+
+typedef struct {
+    PreparedRound rounds[PREFETCH_ROUNDS];
+    int head; // Oldest queued round
+    int count;
+    int targetHaps; // -1 for any board
+    uint64_t generation; // Bumped by a difficulty change
+    uint64_t nextGame;
+    bool stopping;
+    bool threaded; // False if the producer could not start, rounds are dealt on pop
+    const BoardCatalog *catalog;
+    SolutionCache dealtBoards; // Producer thread only, when threaded
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t producer;
+} RoundPrefetch;
+
+bool startRoundPrefetch(RoundPrefetch *prefetch, const BoardCatalog *catalog, uint64_t firstGame, int targetHaps);
+void popPreparedRound(RoundPrefetch *prefetch, PreparedRound *round);
+void setPrefetchTarget(RoundPrefetch *prefetch, int targetHaps);
+void stopRoundPrefetch(RoundPrefetch *prefetch);
+
+#endif
@@ -0,0 +1,166 @@
+#include "gyulhap_render.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+#define HUD_FONT_SIZE 20
+#define HUD_MARGIN 10
+#define GYUL_FONT_SIZE 50
+#define GYUL_FONT_SPACING 5
+
+static const RenderColor HUD_COLOR = {0, 0, 0, 255};
+static const RenderColor GYUL_BUTTON_COLOR = {0, 82, 172, 255};
+static const RenderColor GYUL_LABEL_COLOR = {245, 245, 245, 255};
+
+// Recording backend
+
+static void recordBytes(RenderRecording *recording, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    uint64_t hash = recording->checksum;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    recording->checksum = hash;
+}
+
+static RenderRecording *recordOp(void *context, RenderOp op) {
+    RenderRecording *recording = context;
+    unsigned char code = (unsigned char)op;
+    recording->ops[op]++;
+    recordBytes(recording, &code, 1);
+    return recording;
+}
+
+static void recordClear(void *context, RenderColor color) {
+    recordBytes(recordOp(context, RENDER_CLEAR), &color, sizeof(color));
+}
+
+static void recordRect(void *context, RenderRect rect, RenderColor color) {
+    RenderRecording *recording = recordOp(context, RENDER_RECT);
+    float values[4] = {rect.x, rect.y, rect.width, rect.height};
+    recordBytes(recording, values, sizeof(values));
+    recordBytes(recording, &color, sizeof(color));
+}
+
+static void recordRectLines(void *context, RenderRect rect, float thickness, RenderColor color) {
+    RenderRecording *recording = recordOp(context, RENDER_RECT_LINES);
+    float values[5] = {rect.x, rect.y, rect.width, rect.height, thickness};
+    recordBytes(recording, values, sizeof(values));
+    recordBytes(recording, &color, sizeof(color));
+}
+
+static void recordText(void *context, const char *text, float x, float y, float fontSize, float spacing, RenderColor color) {
+    RenderRecording *recording = recordOp(context, RENDER_TEXT);
+    float values[4] = {x, y, fontSize, spacing};
+    recordBytes(recording, text, strlen(text));
+    recordBytes(recording, values, sizeof(values));
+    recordBytes(recording, &color, sizeof(color));
+}
+
+static void recordTile(void *context, TileId id, bool selected, float x, float y) {
+    RenderRecording *recording = recordOp(context, RENDER_TILE);
+    float values[2] = {x, y};
+    unsigned char tile[2] = {id, selected};
+    recordBytes(recording, tile, sizeof(tile));
+    recordBytes(recording, values, sizeof(values));
+}
+
+// Monospaced stand-in for the default font, close enough for layout
+static float recordMeasureText(void *context, const char *text, float fontSize, float spacing) {
+    (void)context;
+    size_t length = strlen(text);
+    return length == 0 ? 0 : length * (fontSize / 2 + spacing) - spacing;
+}
+
+void initRecordingRenderer(Renderer *renderer, RenderRecording *recording) {
+    memset(recording, 0, sizeof(*recording));
+    recording->checksum = FNV_OFFSET;
+    *renderer = (Renderer){recordClear, recordRect, recordRectLines, recordText, recordTile, recordMeasureText, recording};
+}
+
+void beginRecordedFrame(RenderRecording *recording) {
+    recording->frames++;
+    recording->checksum = FNV_OFFSET;
+}
+
+// Game screen
+
+bool isInsideRect(RenderRect rect, float x, float y) {
+    return x >= rect.x && x <= rect.x + rect.width && y >= rect.y && y <= rect.y + rect.height;
+}
+
+void initGameScene(GameScene *scene, const Renderer *renderer, float windowWidth, GridLayout grid, RenderRect gyulButton) {
+    scene->windowWidth = windowWidth;
+    scene->grid = grid;
+    scene->gyulButton = gyulButton;
+    scene->gyulLabel = "GYUL";
+    scene->gyulLabelX = gyulButton.x + (gyulButton.width - renderer->measureText(renderer->context, scene->gyulLabel, GYUL_FONT_SIZE, GYUL_FONT_SPACING)) / 2;
+    scene->gyulLabelY = gyulButton.y + (gyulButton.height - GYUL_FONT_SIZE) / 2;
+}
+
+// Formats every HUD line for a new round, the game line never changes after
+void startGameHud(GameHud *hud, const GameScene *scene, const Renderer *renderer, const GameState *game, uint64_t gameNumber, int targetHaps) {
+    if (targetHaps < 0) {
+        snprintf(hud->gameText, sizeof(hud->gameText), "Game #%llu", (unsigned long long)gameNumber);
+    } else {
+        snprintf(hud->gameText, sizeof(hud->gameText), "Game #%llu (%d haps)", (unsigned long long)gameNumber, targetHaps);
+    }
+    hud->gameTextX = scene->windowWidth - renderer->measureText(renderer->context, hud->gameText, HUD_FONT_SIZE, HUD_FONT_SIZE / 10) - HUD_MARGIN;
+    hud->remainingHaps = -1;
+    hud->selection = game->selection;
+    hud->score = game->score - 1; // Forces both lines to be formatted
+    hud->secondsLeft = -1;
+    hud->timerText[0] = '\0';
+    updateGameHud(hud, game);
+}
+
+// Reformats only the lines whose value changed, returns what did
+unsigned updateGameHud(GameHud *hud, const GameState *game) {
+    unsigned dirty = 0;
+    if (hud->remainingHaps != game->remainingHaps) {
+        hud->remainingHaps = game->remainingHaps;
+        snprintf(hud->remainingText, sizeof(hud->remainingText), "Remaining Haps: %d", hud->remainingHaps);
+        dirty |= DIRTY_REMAINING;
+    }
+    if (hud->score != game->score) {
+        hud->score = game->score;
+        snprintf(hud->scoreText, sizeof(hud->scoreText), "Score: %d", hud->score);
+        dirty |= DIRTY_SCORE;
+    }
+    if (hud->selection != game->selection) {
+        hud->selection = game->selection;
+        dirty |= DIRTY_BOARD;
+    }
+    return dirty;
+}
+
+// Timed mode's countdown line, in whole seconds
+unsigned updateHudTimer(GameHud *hud, int secondsLeft) {
+    if (hud->secondsLeft == secondsLeft) {
+        return 0;
+    }
+    hud->secondsLeft = secondsLeft;
+    snprintf(hud->timerText, sizeof(hud->timerText), "Time: %d:%02d", secondsLeft / 60, secondsLeft % 60);
+    return DIRTY_TIMER;
+}
+
+void drawGameScene(const Renderer *renderer, const GameScene *scene, const GameHud *hud, const GameState *game) {
+    renderer->text(renderer->context, hud->remainingText, HUD_MARGIN, HUD_MARGIN, HUD_FONT_SIZE, HUD_FONT_SIZE / 10, HUD_COLOR);
+    renderer->text(renderer->context, hud->scoreText, HUD_MARGIN, HUD_MARGIN + 30, HUD_FONT_SIZE, HUD_FONT_SIZE / 10, HUD_COLOR);
+    renderer->text(renderer->context, hud->gameText, hud->gameTextX, HUD_MARGIN, HUD_FONT_SIZE, HUD_FONT_SIZE / 10, HUD_COLOR);
+    if (hud->secondsLeft >= 0) {
+        renderer->text(renderer->context, hud->timerText, HUD_MARGIN, HUD_MARGIN + 60, HUD_FONT_SIZE, HUD_FONT_SIZE / 10, HUD_COLOR);
+    }
+
+    // Tiles, back to back so they batch
+    int pitch = scene->grid.tileSize + scene->grid.spacing;
+    for (int i = 0; i < scene->grid.columns * scene->grid.rows; i++) {
+        float x = scene->grid.x + (i % scene->grid.columns) * pitch;
+        float y = scene->grid.y + (i / scene->grid.columns) * pitch;
+        renderer->tile(renderer->context, game->tiles[i], isPositionSelected(game, i), x, y);
+    }
+
+    renderer->rect(renderer->context, scene->gyulButton, GYUL_BUTTON_COLOR);
+    renderer->text(renderer->context, scene->gyulLabel, scene->gyulLabelX, scene->gyulLabelY, GYUL_FONT_SIZE, GYUL_FONT_SPACING, GYUL_LABEL_COLOR);
+}
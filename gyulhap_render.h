@@ -0,0 +1,84 @@
+#ifndef GYULHAP_RENDER_H
+#define GYULHAP_RENDER_H
+
+#include "gyulhap_core.h"
+#include "gyulhap_input.h"
+
+// Draw calls go through a Renderer, so the game scene has no raylib
+// dependency: the GUI plugs raylib in, and headless code uses the recording
+// backend, which draws nothing and only counts and checksums the commands.
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+} RenderColor;
+
+typedef struct {
+    float x;
+    float y;
+    float width;
+    float height;
+} RenderRect;
+
+typedef enum { RENDER_CLEAR, RENDER_RECT, RENDER_RECT_LINES, RENDER_TEXT, RENDER_TILE, RENDER_OP_COUNT } RenderOp;
+
+typedef struct {
+    void (*clear)(void *context, RenderColor color);
+    void (*rect)(void *context, RenderRect rect, RenderColor color);
+    void (*rectLines)(void *context, RenderRect rect, float thickness, RenderColor color);
+    void (*text)(void *context, const char *text, float x, float y, float fontSize, float spacing, RenderColor color);
+    void (*tile)(void *context, TileId id, bool selected, float x, float y);
+    float (*measureText)(void *context, const char *text, float fontSize, float spacing);
+    void *context;
+} Renderer;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t ops[RENDER_OP_COUNT]; // Since init
+    uint64_t checksum; // FNV-1a of the current frame's commands
+} RenderRecording;
+
+void initRecordingRenderer(Renderer *renderer, RenderRecording *recording);
+void beginRecordedFrame(RenderRecording *recording);
+
+// What changed since the last drawn frame, nothing is drawn while it is 0
+typedef enum {
+    DIRTY_SCREEN = 1 << 0, // Transition or anything off the game screen
+    DIRTY_BOARD = 1 << 1,
+    DIRTY_SCORE = 1 << 2,
+    DIRTY_REMAINING = 1 << 3,
+    DIRTY_TIMER = 1 << 4,
+} DirtyFlags;
+
+// HUD text and the state it was last formatted from
+typedef struct {
+    int remainingHaps;
+    int score;
+    SelectionMask selection;
+    int secondsLeft; // Timed mode, -1 when the round has no clock
+    char remainingText[32];
+    char scoreText[32];
+    char timerText[32];
+    char gameText[48];
+    float gameTextX;
+} GameHud;
+
+typedef struct {
+    float windowWidth;
+    GridLayout grid;
+    RenderRect gyulButton;
+    const char *gyulLabel;
+    float gyulLabelX;
+    float gyulLabelY;
+} GameScene;
+
+bool isInsideRect(RenderRect rect, float x, float y);
+void initGameScene(GameScene *scene, const Renderer *renderer, float windowWidth, GridLayout grid, RenderRect gyulButton);
+void startGameHud(GameHud *hud, const GameScene *scene, const Renderer *renderer, const GameState *game, uint64_t gameNumber, int targetHaps);
+unsigned updateGameHud(GameHud *hud, const GameState *game);
+unsigned updateHudTimer(GameHud *hud, int secondsLeft);
+void drawGameScene(const Renderer *renderer, const GameScene *scene, const GameHud *hud, const GameState *game);
+
+#endif
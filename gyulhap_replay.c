@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_replay.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WRITER_IDLE_NANOS 2000000 // Writer nap when the ring is empty
+
+// Drains whatever the game thread has published, in at most two runs when
+// the span wraps around the end of the ring
+static uint64_t drainRing(ReplayLog *log) {
+    uint64_t tail = log->tail;
+    uint64_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+
+    while (tail != head) {
+        uint64_t start = tail & (REPLAY_RING_SIZE - 1);
+        uint64_t run = head - tail;
+        if (run > REPLAY_RING_SIZE - start) {
+            run = REPLAY_RING_SIZE - start;
+        }
+        if (!log->failed && fwrite(&log->ring[start], sizeof(ReplayRecord), run, log->file) != run) {
+            log->failed = true;
+        }
+        tail += run;
+        __atomic_store_n(&log->tail, tail, __ATOMIC_RELEASE);
+    }
+    return head;
+}
+
+static void *runWriter(void *arg) {
+    ReplayLog *log = arg;
+    struct timespec idle = {0, WRITER_IDLE_NANOS};
+
+    for (;;) {
+        bool stopping = __atomic_load_n(&log->stopping, __ATOMIC_ACQUIRE);
+        uint64_t before = log->tail;
+        if (drainRing(log) == before) {
+            if (stopping) {
+                break;
+            }
+            fflush(log->file);
+            nanosleep(&idle, NULL);
+        }
+    }
+    fflush(log->file);
+    return NULL;
+}
+
+// Appends to path, writing the header first when the file is new. A torn
+// last record from a crash is cut off first, or every record appended after
+// it would be read shifted. A file with another header is left alone, with
+// errno EINVAL.
+bool openReplayLog(ReplayLog *log, const char *path) {
+    struct stat st;
+    ReplayHeader header;
+
+    log->head = 0;
+    log->tail = 0;
+    log->dropped = 0;
+    log->stopping = false;
+    log->failed = false;
+    log->file = fopen(path, "a+b"); // Appends, the header is read back
+    if (log->file == NULL) {
+        return false;
+    }
+
+    int fd = fileno(log->file);
+    if (fstat(fd, &st) != 0) {
+        fclose(log->file);
+        log->file = NULL;
+        return false;
+    }
+    off_t size = st.st_size;
+    if (size < (off_t)sizeof(ReplayHeader)) {
+        size = 0; // Not even a whole header, start over
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+               memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.recordSize != sizeof(ReplayRecord)) {
+        fclose(log->file);
+        log->file = NULL;
+        errno = EINVAL;
+        return false;
+    } else {
+        size -= (size - (off_t)sizeof(ReplayHeader)) % (off_t)sizeof(ReplayRecord);
+    }
+    if (size != st.st_size && ftruncate(fd, size) != 0) {
+        fclose(log->file);
+        log->file = NULL;
+        return false;
+    }
+
+    if (size == 0) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+        header.recordSize = sizeof(ReplayRecord);
+        if (fwrite(&header, sizeof(header), 1, log->file) != 1 || fflush(log->file) != 0) {
+            fclose(log->file);
+            log->file = NULL;
+            return false;
+        }
+    }
+
+    if (pthread_create(&log->writer, NULL, runWriter, log) != 0) {
+        fclose(log->file);
+        log->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+static bool isRingFull(ReplayLog *log) {
+    return log->head - __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE) == REPLAY_RING_SIZE;
+}
+
+// Game thread only. Returns false, and counts the record as dropped, when
+// the writer is a full ring behind.
+bool logReplay(ReplayLog *log, const ReplayRecord *record) {
+    if (log->file == NULL) {
+        return false;
+    }
+    if (isRingFull(log)) {
+        log->dropped++;
+        return false;
+    }
+    log->ring[log->head & (REPLAY_RING_SIZE - 1)] = *record;
+    __atomic_store_n(&log->head, log->head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// For producers that would rather wait than drop, such as batch tools
+void logReplayWait(ReplayLog *log, const ReplayRecord *record) {
+    struct timespec pause = {0, WRITER_IDLE_NANOS / 16};
+    while (log->file != NULL && isRingFull(log)) {
+        nanosleep(&pause, NULL);
+    }
+    logReplay(log, record);
+}
+
+// Waits for the writer to flush everything logged so far
+void closeReplayLog(ReplayLog *log) {
+    if (log->file == NULL) {
+        return;
+    }
+    __atomic_store_n(&log->stopping, true, __ATOMIC_RELEASE);
+    pthread_join(log->writer, NULL);
+    fclose(log->file);
+    log->file = NULL;
+}
+
+bool openReplay(ReplayReader *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ReplayHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const ReplayHeader *header = data;
+    if (memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0 || header->recordSize != sizeof(ReplayRecord)) {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+
+    // A torn last record from a crash is ignored, openReplayLog cuts it off
+    reader->data = data;
+    reader->size = (size_t)st.st_size;
+    reader->records = (const ReplayRecord *)((const uint8_t *)data + sizeof(ReplayHeader));
+    reader->numRecords = (reader->size - sizeof(ReplayHeader)) / sizeof(ReplayRecord);
+    posix_madvise(data, reader->size, POSIX_MADV_SEQUENTIAL);
+    return true;
+}
+
+void closeReplay(ReplayReader *reader) {
+    if (reader->data != NULL) {
+        munmap(reader->data, reader->size);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Record index of every REPLAY_ROUND, followed by numRecords so round r
+// spans [starts[r], starts[r + 1]). Records before the first round are
+// skipped. NULL when out of memory, free() the result.
+uint64_t *indexReplayRounds(const ReplayReader *reader, uint64_t *numRounds) {
+    uint64_t count = 0;
+    for (uint64_t r = 0; r < reader->numRecords; r++) {
+        count += reader->records[r].type == REPLAY_ROUND;
+    }
+
+    uint64_t *starts = malloc((count + 1) * sizeof(uint64_t));
+    if (starts == NULL) {
+        return NULL;
+    }
+    uint64_t round = 0;
+    for (uint64_t r = 0; r < reader->numRecords; r++) {
+        if (reader->records[r].type == REPLAY_ROUND) {
+            starts[round++] = r;
+        }
+    }
+    starts[count] = reader->numRecords;
+    *numRounds = count;
+    return starts;
+}
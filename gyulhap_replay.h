@@ -0,0 +1,74 @@
+#ifndef GYULHAP_REPLAY_H
+#define GYULHAP_REPLAY_H
+
+#include "gyulhap_core.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Every round as a stream of fixed-size records, enough to replay it
+// through the rules exactly.
+//
+// File layout (native endian, sessions append):
+//   ReplayHeader
+//   ReplayRecord records[]
+//
+// The game thread hands records to logReplay, which only copies them into a
+// single-producer single-consumer ring and never blocks. A writer thread
+// drains the ring to the file.
+//
+// A timed round's REPLAY_ROUND is followed by a REPLAY_DEADLINE, and a
+// REPLAY_TIMEOUT ends it if the clock ran out. Toggles and GYULs are only
+// taken before the deadline, so a round with neither a winning GYUL nor a
+// timeout was cut short.
+
+#define REPLAY_MAGIC "GYULRPL1"
+#define REPLAY_PATH "gyulhap.replay"
+#define REPLAY_RING_SIZE 65536 // Records, power of two
+
+typedef enum { REPLAY_ROUND = 1, REPLAY_TOGGLE, REPLAY_GYUL, REPLAY_DEADLINE, REPLAY_TIMEOUT } ReplayType;
+
+typedef struct {
+    char magic[8];
+    uint32_t recordSize;
+    uint32_t reserved;
+} ReplayHeader;
+
+typedef struct {
+    uint8_t type;
+    uint8_t position; // REPLAY_TOGGLE: board position
+    uint8_t result; // REPLAY_TOGGLE: SubmitResult, REPLAY_GYUL: 1 when it ended the round
+    int8_t scoreDelta;
+    uint32_t board; // REPLAY_ROUND: BoardMask
+    uint64_t value; // REPLAY_ROUND: game number, REPLAY_DEADLINE and REPLAY_TIMEOUT: the deadline, otherwise monotonic nanoseconds
+} ReplayRecord;
+
+typedef struct {
+    ReplayRecord ring[REPLAY_RING_SIZE];
+    uint64_t head; // Next slot the game thread fills
+    char padding[64];
+    uint64_t tail; // Next slot the writer drains
+    char padding2[64];
+    uint64_t dropped; // Records that found the ring full
+    bool stopping;
+    bool failed; // A write failed, later records are discarded
+    FILE *file;
+    pthread_t writer;
+} ReplayLog;
+
+typedef struct {
+    void *data;
+    size_t size;
+    const ReplayRecord *records;
+    uint64_t numRecords;
+} ReplayReader;
+
+bool openReplayLog(ReplayLog *log, const char *path);
+bool logReplay(ReplayLog *log, const ReplayRecord *record);
+void logReplayWait(ReplayLog *log, const ReplayRecord *record);
+void closeReplayLog(ReplayLog *log);
+bool openReplay(ReplayReader *reader, const char *path);
+void closeReplay(ReplayReader *reader);
+uint64_t *indexReplayRounds(const ReplayReader *reader, uint64_t *numRounds);
+
+#endif
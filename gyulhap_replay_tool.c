@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_replay.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_pool.h"
+#include "gyulhap_rng.h"
+#include "gyulhap_seed.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Replays a log through the rules and checks that every toggle and GYUL
+// scores exactly as recorded. Rounds are independent, so they are spread
+// over all cores.
+//
+// -w writes simulated games first: a player that finds every hap, with the
+// odd wrong or repeated pick and early GYUL, logged through the same ring
+// and writer thread as the game.
+
+#define ROUND_GRAIN 1024
+
+typedef struct {
+    uint64_t rounds;
+    uint64_t completed; // Won by a GYUL
+    uint64_t timeouts;
+    uint64_t toggles;
+    uint64_t haps;
+    uint64_t mistakes; // Wrong and repeated haps, early GYULs
+    uint64_t mismatches;
+    int64_t score;
+    char padding[64];
+} ReplayStats;
+
+typedef struct {
+    const ReplayReader *reader;
+    const uint64_t *roundStarts; // Record index of every REPLAY_ROUND, plus the end
+    ReplayStats *workers;
+} Verification;
+
+static void replayRound(const ReplayRecord *records, uint64_t begin, uint64_t end, ReplayStats *stats) {
+    GameState game;
+    TileId boardTiles[NUM_TILES];
+    BoardMask board = records[begin].board;
+
+    // A corrupt round is a mismatch, not a board to play
+    stats->rounds++;
+    if (!isBoardMask(board)) {
+        stats->mismatches++;
+        return;
+    }
+    seededBoardTiles(board, records[begin].value, boardTiles);
+    startRound(&game, boardTiles);
+    uint64_t deadline = 0;
+    bool timedOut = false;
+
+    for (uint64_t r = begin + 1; r < end; r++) {
+        const ReplayRecord *record = &records[r];
+        int before = game.score;
+        bool isClaim = record->type == REPLAY_TOGGLE || record->type == REPLAY_GYUL;
+
+        // Nothing is taken once the clock has run out
+        if (isClaim && (timedOut || (deadline != 0 && record->value >= deadline))) {
+            stats->mismatches++;
+        } else if (record->type == REPLAY_DEADLINE) {
+            if (r != begin + 1) {
+                stats->mismatches++;
+            }
+            deadline = record->value;
+        } else if (record->type == REPLAY_TIMEOUT) {
+            if (deadline == 0 || record->value != deadline || game.isGameOver) {
+                stats->mismatches++;
+            }
+            timedOut = true;
+            game.isGameOver = true;
+        } else if (record->type == REPLAY_TOGGLE && record->position >= NUM_TILES) {
+            stats->mismatches++;
+        } else if (record->type == REPLAY_TOGGLE) {
+            SubmitResult result = togglePosition(&game, record->position);
+            stats->toggles++;
+            stats->haps += result == SUBMIT_HAP;
+            stats->mistakes += result == SUBMIT_WRONG || result == SUBMIT_DUPLICATE;
+            if (result != record->result || game.score - before != record->scoreDelta) {
+                stats->mismatches++;
+            }
+        } else if (record->type == REPLAY_GYUL) {
+            claimGyul(&game);
+            stats->mistakes += !game.isGameOver;
+            if (game.isGameOver != (record->result != 0) || game.score - before != record->scoreDelta) {
+                stats->mismatches++;
+            }
+        } else {
+            stats->mismatches++;
+        }
+    }
+
+    stats->completed += game.isGameOver && !timedOut;
+    stats->timeouts += timedOut;
+    stats->score += game.score;
+}
+
+static void verifyChunk(void *context, int worker, uint64_t begin, uint64_t end) {
+    Verification *verification = context;
+    for (uint64_t round = begin; round < end; round++) {
+        replayRound(verification->reader->records, verification->roundStarts[round], verification->roundStarts[round + 1], &verification->workers[worker]);
+    }
+}
+
+static void logToggle(ReplayLog *log, GameState *game, int position) {
+    int before = game->score;
+    SubmitResult result = togglePosition(game, position);
+    ReplayRecord record = {REPLAY_TOGGLE, (uint8_t)position, (uint8_t)result, (int8_t)(game->score - before), 0, monotonicNanos()};
+    logReplayWait(log, &record);
+}
+
+static void logGyul(ReplayLog *log, GameState *game) {
+    int before = game->score;
+    claimGyul(game);
+    ReplayRecord record = {REPLAY_GYUL, 0, game->isGameOver, (int8_t)(game->score - before), 0, monotonicNanos()};
+    logReplayWait(log, &record);
+}
+
+static void simulateGame(ReplayLog *log, uint64_t gameNumber, GyulRng *rng) {
+    GameState game;
+    TileId boardTiles[NUM_TILES];
+    uint8_t hapPositions[MAX_HAPS][3];
+    BoardMask board = boardFromSeed(gameNumber);
+
+    seededBoardTiles(board, gameNumber, boardTiles);
+    int numHaps = findHapsPacked(boardTiles, NUM_TILES, hapPositions);
+    startRound(&game, boardTiles);
+    ReplayRecord round = {REPLAY_ROUND, 0, 0, 0, board, gameNumber};
+    logReplayWait(log, &round);
+
+    for (int h = 0; h < numHaps; h++) {
+        if (rngBelow(rng, 8) == 0) {
+            logGyul(log, &game);
+        }
+        if (rngBelow(rng, 4) == 0) {
+            // Any three positions, usually not a hap
+            for (int picked = 0; picked < 3;) {
+                int position = (int)rngBelow(rng, NUM_TILES);
+                if (!isPositionSelected(&game, position)) {
+                    logToggle(log, &game, position);
+                    picked++;
+                }
+            }
+        }
+
+        int first = (int)rngBelow(rng, 3);
+        int repeats = rngBelow(rng, 8) == 0 ? 2 : 1;
+        for (int repeat = 0; repeat < repeats; repeat++) {
+            for (int t = 0; t < 3; t++) {
+                logToggle(log, &game, hapPositions[h][(first + t) % 3]);
+            }
+        }
+    }
+    logGyul(log, &game);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-i file] [-w games] [-g first game] [-s seed] [-t threads]\n"
+            "  -i  replay log (default " REPLAY_PATH ")\n"
+            "  -w  append this many simulated games first\n"
+            "  -g  game number of the first simulated game (default 0)\n"
+            "  -s  64-bit seed of the simulated player (default 42)\n"
+            "  -t  worker threads (default: all cores)\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    const char *path = REPLAY_PATH;
+    unsigned long long numSimulated = 0;
+    uint64_t firstGame = 0;
+    uint64_t seed = 42;
+    int numThreads = defaultThreadCount();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            numSimulated = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            firstGame = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+
+    if (numSimulated > 0) {
+        static ReplayLog log;
+        GyulRng rng;
+        if (!openReplayLog(&log, path)) {
+            perror(path);
+            return 1;
+        }
+        seedRng(&rng, seed);
+        uint64_t start = monotonicNanos();
+        for (unsigned long long g = 0; g < numSimulated; g++) {
+            simulateGame(&log, firstGame + g, &rng);
+        }
+        closeReplayLog(&log);
+        double elapsed = (monotonicNanos() - start) / 1e9;
+        fprintf(stderr, "simulated: %llu  seconds: %.3f  games/sec: %.0f%s\n", numSimulated, elapsed,
+                elapsed > 0 ? numSimulated / elapsed : 0.0, log.failed ? "  (write failed)" : "");
+    }
+
+    ReplayReader reader;
+    if (!openReplay(&reader, path)) {
+        fprintf(stderr, "%s: not a replay log\n", path);
+        return 1;
+    }
+
+    // Rounds are found in one sequential pass, then replayed in parallel
+    uint64_t start = monotonicNanos();
+    uint64_t numRounds;
+    uint64_t *roundStarts = indexReplayRounds(&reader, &numRounds);
+    ReplayStats *workers = calloc((size_t)numThreads, sizeof(ReplayStats));
+    if (roundStarts == NULL || workers == NULL) {
+        perror("replay");
+        return 1;
+    }
+
+    Verification verification = {&reader, roundStarts, workers};
+    if (!parallelFor(numRounds, ROUND_GRAIN, numThreads, verifyChunk, &verification)) {
+        perror("parallelFor");
+        return 1;
+    }
+    double elapsed = (monotonicNanos() - start) / 1e9;
+
+    ReplayStats total = {0};
+    for (int w = 0; w < numThreads; w++) {
+        total.rounds += workers[w].rounds;
+        total.completed += workers[w].completed;
+        total.timeouts += workers[w].timeouts;
+        total.toggles += workers[w].toggles;
+        total.haps += workers[w].haps;
+        total.mistakes += workers[w].mistakes;
+        total.mismatches += workers[w].mismatches;
+        total.score += workers[w].score;
+    }
+
+    printf("%s: %llu records  rounds: %llu  completed: %llu  timeouts: %llu  toggles: %llu  haps: %llu  mistakes: %llu\n",
+           path, (unsigned long long)reader.numRecords, (unsigned long long)total.rounds, (unsigned long long)total.completed,
+           (unsigned long long)total.timeouts,
+           (unsigned long long)total.toggles, (unsigned long long)total.haps, (unsigned long long)total.mistakes);
+    printf("mean score: %.3f  mismatches: %llu  seconds: %.3f  rounds/sec: %.0f\n",
+           total.rounds > 0 ? (double)total.score / total.rounds : 0.0, (unsigned long long)total.mismatches,
+           elapsed, elapsed > 0 ? total.rounds / elapsed : 0.0);
+
+    free(roundStarts);
+    free(workers);
+    closeReplay(&reader);
+    return total.mismatches == 0 ? 0 : 2;
+}
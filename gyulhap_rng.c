@@ -0,0 +1,56 @@
+#include "gyulhap_rng.h"
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Expands the seed with splitmix64, which never yields the all-zero state
+void seedRng(GyulRng *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t nextRng(GyulRng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// Uniform in [0, bound) without modulo bias (Lemire's multiply-shift)
+uint32_t rngBelow(GyulRng *rng, uint32_t bound) {
+    uint64_t product = (nextRng(rng) >> 32) * bound;
+    uint32_t low = (uint32_t)product;
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            product = (nextRng(rng) >> 32) * bound;
+            low = (uint32_t)product;
+        }
+    }
+    return (uint32_t)(product >> 32);
+}
+
+// Partial Fisher-Yates: only the first boardSize slots of the deck need to
+// be random, and they are copied to the board
+void dealTiles(TileId *deck, int deckSize, TileId *boardTiles, int boardSize, GyulRng *rng) {
+    for (int i = 0; i < boardSize; i++) {
+        int j = i + (int)rngBelow(rng, (uint32_t)(deckSize - i));
+        TileId temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+        boardTiles[i] = deck[i];
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef GYULHAP_RNG_H
+#define GYULHAP_RNG_H
+
+#include "gyulhap_core.h"
+
+// xoshiro256**: small and fast. Parallel work seeds one generator per block
+// of work, not per thread, so its results don't depend on the thread count.
+
+typedef struct {
+    uint64_t s[4];
+} GyulRng;
+
+void seedRng(GyulRng *rng, uint64_t seed);
+uint64_t nextRng(GyulRng *rng);
+uint32_t rngBelow(GyulRng *rng, uint32_t bound);
+void dealTiles(TileId *deck, int deckSize, TileId *boardTiles, int boardSize, GyulRng *rng);
+
+#endif
@@ -0,0 +1,56 @@
+#include "gyulhap_seed.h"
+#include "gyulhap_rng.h"
+
+#define RANK_BITS 24 // 2^24 > NUM_BOARDS
+#define HALF_BITS (RANK_BITS / 2)
+#define HALF_MASK ((1u << HALF_BITS) - 1)
+#define FEISTEL_ROUNDS 4
+#define SEED_KEY 0x6779756C68617021ULL
+
+static uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Keyed Feistel network, a bijection on [0, 2^24)
+static uint32_t permute24(uint32_t x, uint64_t key) {
+    uint32_t left = x >> HALF_BITS;
+    uint32_t right = x & HALF_MASK;
+
+    for (int round = 0; round < FEISTEL_ROUNDS; round++) {
+        uint32_t next = left ^ (uint32_t)(mix64(key + (uint64_t)round * 0x9E3779B97F4A7C15ULL + right) & HALF_MASK);
+        left = right;
+        right = next;
+    }
+    return (left << HALF_BITS) | right;
+}
+
+// Bijection on [0, NUM_BOARDS): cycle-walks permute24 until it lands back
+// in range, about 3.6 rounds on average
+uint32_t permuteRank(uint32_t rank, uint64_t key) {
+    do {
+        rank = permute24(rank, key);
+    } while (rank >= NUM_BOARDS);
+    return rank;
+}
+
+BoardMask boardFromSeed(uint64_t seed) {
+    uint64_t key = mix64(seed / NUM_BOARDS ^ SEED_KEY);
+    return unrankBoard(permuteRank((uint32_t)(seed % NUM_BOARDS), key));
+}
+
+// A board's on-screen order for a seed
+void seededBoardTiles(BoardMask board, uint64_t seed, TileId *boardTiles) {
+    TileId sorted[NUM_TILES];
+    GyulRng rng;
+
+    maskToTiles(board, sorted);
+    seedRng(&rng, seed);
+    dealTiles(sorted, NUM_TILES, boardTiles, NUM_TILES, &rng);
+}
+
+// Stateless pick in [0, count), for seeded choices within a smaller set
+uint32_t seededIndex(uint64_t seed, uint32_t count) {
+    return (uint32_t)(((mix64(seed ^ SEED_KEY) >> 32) * count) >> 32);
+}
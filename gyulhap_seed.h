@@ -0,0 +1,17 @@
+#ifndef GYULHAP_SEED_H
+#define GYULHAP_SEED_H
+
+#include "gyulhap_core.h"
+
+// Boards addressed directly by a 64-bit seed or game number, with no
+// generator state. Seed n picks colex rank permuteRank(n mod NUM_BOARDS)
+// under a key taken from the rest of the seed, so game numbers 0 to
+// NUM_BOARDS - 1 are all different boards. The tile order on screen is
+// drawn from the seed too.
+
+uint32_t permuteRank(uint32_t rank, uint64_t key);
+BoardMask boardFromSeed(uint64_t seed);
+void seededBoardTiles(BoardMask board, uint64_t seed, TileId *boardTiles);
+uint32_t seededIndex(uint64_t seed, uint32_t count);
+
+#endif
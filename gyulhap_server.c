@@ -0,0 +1,822 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_net.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_seed.h"
+#include "gyulhap_stats.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Authoritative rooms for the race version: every player in a room sees the
+// same board and the server scores claims in the order they arrive, so the
+// first valid claim of a hap wins it and later ones are duplicates. Claims
+// and GYULs go through submitSelection and claimGyul, exactly as in the
+// game. A valid GYUL deals the room's next round. Claims and GYULs name
+// the round they are for; one that arrives after its round ended lost the
+// race to the winning GYUL and is answered NET_ERROR_STALE, unscored.
+//
+// One thread, one epoll loop, every socket non-blocking. Replies are queued
+// per connection while a batch of events is handled and written once at
+// the end of it; a player whose queue fills up is disconnected rather than
+// slowing the room down. Room r's round k is game number
+// first + r * 2^32 + k. See gyulhap_net.h for the protocol.
+//
+// Spectators get the room as deltas. Every scored claim or GYUL is encoded
+// once into the room's pending SharedBuffer, and at the end of the batch
+// that buffer is handed by reference to each spectator's queue and written
+// from there with writev, so a delta costs a pointer per viewer, not a copy.
+// A spectator whose queue is full has it replaced by a fresh snapshot; one
+// that needs MAX_RESYNCS of those in a row without catching up is dropped.
+//
+// With -S every player's round goes to a stats store when it ends or they
+// leave. The protocol carries no identities, so a player is a connection:
+// ids are handed out in order from a per-run base.
+
+#define DEFAULT_ROOMS 4096
+#define ROOM_MAX_PLAYERS NET_MAX_PLAYERS
+#define MAX_EVENTS 256
+#define IN_BUFFER_SIZE (64 * sizeof(NetMessage))
+#define OUT_BUFFER_SIZE (256 * sizeof(NetMessage)) // A player this far behind is dropped
+#define STATS_SECONDS 10
+#define SPECTATOR_QUEUE 64 // Shared buffers a spectator may fall behind by
+#define MAX_RESYNCS 4
+#define DELTA_BUFFER_SIZE 4096
+
+// Frames serialized once and referenced from every spectator queue, freed
+// with the last reference
+typedef struct {
+    uint32_t refs;
+    uint32_t size;
+    unsigned char data[];
+} SharedBuffer;
+
+typedef struct Connection {
+    int fd;
+    int room; // -1 until joined
+    int player;
+    uint64_t playerId; // In the stats store
+    bool writing; // EPOLLOUT is on
+    bool closing;
+    bool queued; // On the flush list
+    struct Connection *nextFlush;
+    int watching; // Room, -1 unless a spectator
+    int spectatorIndex; // Slot in the room's spectators
+    int resyncs; // Since the queue last drained
+    int queueHead;
+    int queueCount;
+    size_t queueOffset; // Bytes of the head buffer already sent
+    SharedBuffer *queue[SPECTATOR_QUEUE];
+    size_t inBytes;
+    size_t outStart;
+    size_t outEnd;
+    unsigned char in[IN_BUFFER_SIZE];
+    unsigned char out[OUT_BUFFER_SIZE];
+} Connection;
+
+typedef struct Room {
+    GameState game;
+    uint64_t gameNumber;
+    uint32_t rounds;
+    int numPlayers;
+    Connection *players[ROOM_MAX_PLAYERS];
+    int16_t scores[ROOM_MAX_PLAYERS]; // This round's, by slot
+    RoundTally tallies[ROOM_MAX_PLAYERS];
+    Connection **spectators;
+    int numSpectators;
+    int spectatorCapacity;
+    SharedBuffer *pending; // Frames not yet handed to the spectators
+    bool pendingListed;
+    struct Room *nextPending;
+} Room;
+
+typedef struct {
+    uint64_t connections;
+    uint64_t dropped; // Disconnected for falling behind
+    uint64_t rounds;
+    uint64_t claims;
+    uint64_t gyuls;
+    uint64_t errors;
+    uint64_t stale; // Claims and GYULs for a round already over
+    uint64_t spectators;
+    uint64_t resyncs;
+    uint64_t spectatorDrops;
+    uint64_t publishedBytes; // Encoded once per room
+    uint64_t fanoutBytes; // Written to spectators
+    LatencyHistogram arbitration; // Message read to result queued, nanoseconds
+} ServerStats;
+
+typedef struct {
+    int epoll;
+    int listener;
+    Room *rooms;
+    uint32_t numRooms;
+    uint64_t firstGame;
+    Connection *flushList;
+    Room *pendingRooms;
+    StatsStore *statsStore; // NULL without -S
+    uint64_t nextPlayerId;
+    ServerStats stats;
+} Server;
+
+static volatile sig_atomic_t stopRequested;
+
+static void requestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+static void queueFlush(Server *server, Connection *connection) {
+    if (!connection->queued) {
+        connection->queued = true;
+        connection->nextFlush = server->flushList;
+        server->flushList = connection;
+    }
+}
+
+static SharedBuffer *newSharedBuffer(size_t capacity) {
+    SharedBuffer *buffer = malloc(sizeof(SharedBuffer) + capacity);
+    if (buffer == NULL) {
+        perror("spectator buffer");
+        exit(1);
+    }
+    buffer->refs = 0;
+    buffer->size = 0;
+    return buffer;
+}
+
+static void releaseBuffer(SharedBuffer *buffer) {
+    if (--buffer->refs == 0) {
+        free(buffer);
+    }
+}
+
+static void writeSnapshot(const Room *room, NetSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->type = NET_SNAPSHOT;
+    snapshot->remainingHaps = (uint8_t)room->game.remainingHaps;
+    for (int p = 0; p < ROOM_MAX_PLAYERS; p++) {
+        snapshot->players |= (uint16_t)((room->players[p] != NULL) << p);
+        snapshot->scores[p] = room->scores[p];
+    }
+    snapshot->gameNumber = room->gameNumber;
+    snapshot->foundLines[0] = room->game.foundLines[0];
+    snapshot->foundLines[1] = room->game.foundLines[1];
+}
+
+static bool enqueueBuffer(Server *server, Connection *spectator, SharedBuffer *buffer) {
+    if (spectator->queueCount == SPECTATOR_QUEUE) {
+        return false;
+    }
+    spectator->queue[(spectator->queueHead + spectator->queueCount++) % SPECTATOR_QUEUE] = buffer;
+    buffer->refs++;
+    queueFlush(server, spectator);
+    return true;
+}
+
+// Drops the queue (but finishes a half-sent buffer, frames can't be cut)
+static void clearQueue(Connection *connection) {
+    int keep = connection->queueCount > 0 && connection->queueOffset > 0;
+    for (int i = keep; i < connection->queueCount; i++) {
+        releaseBuffer(connection->queue[(connection->queueHead + i) % SPECTATOR_QUEUE]);
+    }
+    connection->queueCount = keep;
+}
+
+static void sendSnapshot(Server *server, Room *room, Connection *spectator) {
+    SharedBuffer *buffer = newSharedBuffer(sizeof(NetSnapshot));
+    NetSnapshot snapshot;
+    writeSnapshot(room, &snapshot);
+    memcpy(buffer->data, &snapshot, sizeof(snapshot));
+    buffer->size = sizeof(snapshot);
+    buffer->refs = 1;
+    enqueueBuffer(server, spectator, buffer);
+    releaseBuffer(buffer);
+}
+
+static void dropConnection(Server *server, Connection *connection);
+
+// The queued stream is replaced by the room as it is now
+static void resyncSpectator(Server *server, Room *room, Connection *spectator) {
+    if (++spectator->resyncs > MAX_RESYNCS) {
+        server->stats.spectatorDrops++;
+        dropConnection(server, spectator);
+        return;
+    }
+    server->stats.resyncs++;
+    clearQueue(spectator);
+    sendSnapshot(server, room, spectator);
+}
+
+// Hands the pending frames to every spectator, one reference each
+static void publishRoom(Server *server, Room *room) {
+    SharedBuffer *buffer = room->pending;
+    if (buffer == NULL) {
+        return;
+    }
+    room->pending = NULL;
+    server->stats.publishedBytes += buffer->size;
+
+    buffer->refs = 1; // Held while fanning out
+    for (int i = room->numSpectators - 1; i >= 0; i--) {
+        if (!enqueueBuffer(server, room->spectators[i], buffer)) {
+            resyncSpectator(server, room, room->spectators[i]);
+        }
+    }
+    releaseBuffer(buffer);
+}
+
+static void appendFrame(Server *server, Room *room, const void *frame, size_t size) {
+    if (room->numSpectators == 0) {
+        return;
+    }
+    if (room->pending != NULL && room->pending->size + size > DELTA_BUFFER_SIZE) {
+        publishRoom(server, room);
+    }
+    if (room->pending == NULL) {
+        room->pending = newSharedBuffer(DELTA_BUFFER_SIZE);
+        if (!room->pendingListed) {
+            room->pendingListed = true;
+            room->nextPending = server->pendingRooms;
+            server->pendingRooms = room;
+        }
+    }
+    memcpy(room->pending->data + room->pending->size, frame, size);
+    room->pending->size += (uint32_t)size;
+}
+
+static void appendDelta(Server *server, Room *room, NetType type, int player, int scoreDelta, unsigned value) {
+    NetDelta delta = {(uint8_t)type, (int8_t)scoreDelta, (uint16_t)(player << 12 | value)};
+    room->scores[player] += (int16_t)scoreDelta;
+    appendFrame(server, room, &delta, sizeof(delta));
+}
+
+static void appendSnapshot(Server *server, Room *room) {
+    NetSnapshot snapshot;
+    if (room->numSpectators > 0) {
+        writeSnapshot(room, &snapshot);
+        appendFrame(server, room, &snapshot, sizeof(snapshot));
+    }
+}
+
+static void publishPending(Server *server) {
+    while (server->pendingRooms != NULL) {
+        Room *room = server->pendingRooms;
+        server->pendingRooms = room->nextPending;
+        room->pendingListed = false;
+        publishRoom(server, room);
+    }
+}
+
+static void recordTally(Server *server, Room *room, int player, bool finished) {
+    StatsRecord record;
+    if (server->statsStore != NULL) {
+        finishTally(&room->tallies[player], room->scores[player], finished, monotonicNanos(), &record);
+        appendStats(server->statsStore, &record);
+    }
+}
+
+static void leaveRoom(Server *server, Connection *connection) {
+    if (connection->room >= 0) {
+        Room *room = &server->rooms[connection->room];
+        recordTally(server, room, connection->player, false);
+        room->players[connection->player] = NULL;
+        room->numPlayers--;
+        connection->room = -1;
+        appendSnapshot(server, room);
+    }
+    if (connection->watching >= 0) {
+        Room *room = &server->rooms[connection->watching];
+        Connection *last = room->spectators[--room->numSpectators];
+        room->spectators[connection->spectatorIndex] = last;
+        last->spectatorIndex = connection->spectatorIndex;
+        connection->watching = -1;
+    }
+}
+
+static void freeConnection(Connection *connection) {
+    connection->queueOffset = 0;
+    clearQueue(connection);
+    close(connection->fd);
+    free(connection);
+}
+
+// Closed once the current batch is flushed, nothing else refers to it
+static void dropConnection(Server *server, Connection *connection) {
+    if (!connection->closing) {
+        connection->closing = true;
+        leaveRoom(server, connection);
+        queueFlush(server, connection);
+    }
+}
+
+static void sendMessage(Server *server, Connection *connection, const NetMessage *message) {
+    if (connection->closing) {
+        return;
+    }
+    if (connection->outEnd + sizeof(*message) > OUT_BUFFER_SIZE) {
+        server->stats.dropped++;
+        dropConnection(server, connection);
+        return;
+    }
+    memcpy(connection->out + connection->outEnd, message, sizeof(*message));
+    connection->outEnd += sizeof(*message);
+    queueFlush(server, connection);
+}
+
+static void broadcast(Server *server, Room *room, const NetMessage *message) {
+    for (int p = 0; p < ROOM_MAX_PLAYERS; p++) {
+        if (room->players[p] != NULL) {
+            sendMessage(server, room->players[p], message);
+        }
+    }
+}
+
+static void sendError(Server *server, Connection *connection, NetError error, uint64_t value) {
+    NetMessage message = {NET_ERROR, 0, (uint8_t)error, 0, {0, 0, 0}, 0, value};
+    if (error == NET_ERROR_STALE) {
+        server->stats.stale++;
+    } else {
+        server->stats.errors++;
+    }
+    sendMessage(server, connection, &message);
+}
+
+static void sendRound(Server *server, Room *room, Connection *connection) {
+    NetMessage message = {NET_ROUND, (uint8_t)connection->player, 0, 0, {0, 0, 0}, (uint8_t)room->game.remainingHaps, room->gameNumber};
+    sendMessage(server, connection, &message);
+}
+
+static void startRoomRound(Server *server, uint32_t roomIndex) {
+    Room *room = &server->rooms[roomIndex];
+    TileId boardTiles[NUM_TILES];
+
+    room->gameNumber = server->firstGame + ((uint64_t)roomIndex << 32) + room->rounds++;
+    seededBoardTiles(boardFromSeed(room->gameNumber), room->gameNumber, boardTiles);
+    startRound(&room->game, boardTiles);
+    memset(room->scores, 0, sizeof(room->scores));
+    server->stats.rounds++;
+    appendSnapshot(server, room);
+
+    uint64_t now = monotonicNanos();
+    for (int p = 0; p < ROOM_MAX_PLAYERS; p++) {
+        if (room->players[p] != NULL) {
+            startTally(&room->tallies[p], room->players[p]->playerId, room->gameNumber, room->game.numHaps, now);
+            sendRound(server, room, room->players[p]);
+        }
+    }
+}
+
+static void joinRoom(Server *server, Connection *connection, uint64_t roomNumber) {
+    if (roomNumber >= server->numRooms) {
+        sendError(server, connection, NET_ERROR_ROOM, roomNumber);
+        return;
+    }
+    Room *room = &server->rooms[roomNumber];
+    if (connection->room == (int)roomNumber) {
+        sendRound(server, room, connection);
+        return;
+    }
+    if (room->numPlayers == ROOM_MAX_PLAYERS) {
+        sendError(server, connection, NET_ERROR_FULL, roomNumber);
+        return;
+    }
+
+    leaveRoom(server, connection);
+    int player = 0;
+    while (room->players[player] != NULL) {
+        player++;
+    }
+    room->players[player] = connection;
+    room->numPlayers++;
+    connection->room = (int)roomNumber;
+    connection->player = player;
+    room->scores[player] = 0;
+
+    if (room->rounds == 0) {
+        startRoomRound(server, (uint32_t)roomNumber);
+    } else {
+        startTally(&room->tallies[player], connection->playerId, room->gameNumber, room->game.numHaps, monotonicNanos());
+        sendRound(server, room, connection);
+        appendSnapshot(server, room);
+    }
+}
+
+// The connection becomes a spectator of the room, starting from a snapshot
+static void watchRoom(Server *server, Connection *connection, uint64_t roomNumber) {
+    if (roomNumber >= server->numRooms) {
+        sendError(server, connection, NET_ERROR_ROOM, roomNumber);
+        return;
+    }
+    Room *room = &server->rooms[roomNumber];
+    if (room->numSpectators == room->spectatorCapacity) {
+        int capacity = room->spectatorCapacity ? room->spectatorCapacity * 2 : 16;
+        Connection **spectators = realloc(room->spectators, (size_t)capacity * sizeof(Connection *));
+        if (spectators == NULL) {
+            sendError(server, connection, NET_ERROR_FULL, roomNumber);
+            return;
+        }
+        room->spectators = spectators;
+        room->spectatorCapacity = capacity;
+    }
+
+    leaveRoom(server, connection);
+    if (room->rounds == 0) {
+        startRoomRound(server, (uint32_t)roomNumber);
+    }
+    // Frames from before the snapshot only go to the earlier spectators
+    publishRoom(server, room);
+
+    connection->watching = (int)roomNumber;
+    connection->spectatorIndex = room->numSpectators;
+    connection->resyncs = 0;
+    room->spectators[room->numSpectators++] = connection;
+    server->stats.spectators++;
+    sendSnapshot(server, room, connection);
+}
+
+// The three positions become the room's selection and are scored as one
+// submission, the claimant gets the score delta
+static void claimHap(Server *server, Connection *connection, const NetMessage *claim) {
+    Room *room = &server->rooms[connection->room];
+    SelectionMask selection = 0;
+    for (int i = 0; i < 3; i++) {
+        if (claim->positions[i] >= NUM_TILES) {
+            sendError(server, connection, NET_ERROR_POSITIONS, claim->value);
+            return;
+        }
+        selection |= (SelectionMask)(1u << claim->positions[i]);
+    }
+    if (__builtin_popcount(selection) != MAX_SELECTED_TILES) {
+        sendError(server, connection, NET_ERROR_POSITIONS, claim->value);
+        return;
+    }
+
+    int before = room->game.score;
+    room->game.selection = selection;
+    SubmitResult result = submitSelection(&room->game);
+    NetMessage message = {NET_RESULT, (uint8_t)connection->player, (uint8_t)result, (int8_t)(room->game.score - before),
+                          {claim->positions[0], claim->positions[1], claim->positions[2]}, (uint8_t)room->game.remainingHaps, claim->value};
+    server->stats.claims++;
+    broadcast(server, room, &message);
+    if (server->statsStore != NULL) {
+        tallyClaim(&room->tallies[connection->player], result, monotonicNanos());
+    }
+
+    if (result == SUBMIT_HAP) {
+        TileId a = room->game.tiles[claim->positions[0]];
+        TileId b = room->game.tiles[claim->positions[1]];
+        appendDelta(server, room, NET_DELTA_HAP, connection->player, message.scoreDelta, HAP_LINE_OF[a][b]);
+    } else {
+        appendDelta(server, room, result == SUBMIT_DUPLICATE ? NET_DELTA_DUPLICATE : NET_DELTA_WRONG, connection->player, message.scoreDelta, selection);
+    }
+}
+
+static void claimRoomGyul(Server *server, Connection *connection, const NetMessage *gyul) {
+    Room *room = &server->rooms[connection->room];
+    int before = room->game.score;
+    claimGyul(&room->game);
+    bool won = room->game.isGameOver;
+    NetMessage message = {NET_RESULT, (uint8_t)connection->player, won ? NET_GYUL_WON : NET_GYUL_WRONG, (int8_t)(room->game.score - before),
+                          {0, 0, 0}, (uint8_t)room->game.remainingHaps, gyul->value};
+    server->stats.gyuls++;
+    broadcast(server, room, &message);
+    appendDelta(server, room, won ? NET_DELTA_GYUL_WON : NET_DELTA_GYUL_WRONG, connection->player, message.scoreDelta, 0);
+    tallyGyul(&room->tallies[connection->player], won);
+
+    if (won) {
+        for (int p = 0; p < ROOM_MAX_PLAYERS; p++) {
+            if (room->players[p] != NULL) {
+                recordTally(server, room, p, true);
+            }
+        }
+        startRoomRound(server, (uint32_t)connection->room);
+    }
+}
+
+static void handleMessage(Server *server, Connection *connection, const NetMessage *message) {
+    if (connection->watching >= 0 && message->type != NET_WATCH) {
+        dropConnection(server, connection); // Spectators only switch rooms
+        return;
+    }
+    switch (message->type) {
+        case NET_WATCH:
+            watchRoom(server, connection, message->value);
+            break;
+        case NET_JOIN:
+            joinRoom(server, connection, message->value);
+            break;
+        case NET_CLAIM:
+        case NET_GYUL:
+            if (connection->room < 0) {
+                sendError(server, connection, NET_ERROR_NOT_JOINED, message->value);
+            } else if (message->value != server->rooms[connection->room].gameNumber) {
+                sendError(server, connection, NET_ERROR_STALE, message->value);
+            } else if (message->type == NET_CLAIM) {
+                claimHap(server, connection, message);
+            } else {
+                claimRoomGyul(server, connection, message);
+            }
+            break;
+        default:
+            // Not a client message, the stream can't be trusted any more
+            dropConnection(server, connection);
+            break;
+    }
+}
+
+static void readConnection(Server *server, Connection *connection) {
+    for (;;) {
+        ssize_t count = read(connection->fd, connection->in + connection->inBytes, IN_BUFFER_SIZE - connection->inBytes);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            dropConnection(server, connection);
+            return;
+        }
+        if (count < 0) {
+            return;
+        }
+
+        uint64_t received = monotonicNanos();
+        size_t available = connection->inBytes + (size_t)count;
+        size_t offset = 0;
+        for (; offset + sizeof(NetMessage) <= available && !connection->closing; offset += sizeof(NetMessage)) {
+            NetMessage message;
+            memcpy(&message, connection->in + offset, sizeof(message));
+            handleMessage(server, connection, &message);
+            recordLatency(&server->stats.arbitration, monotonicNanos() - received);
+        }
+        if (connection->closing) {
+            return;
+        }
+        connection->inBytes = available - offset;
+        memmove(connection->in, connection->in + offset, connection->inBytes);
+    }
+}
+
+static void acceptConnections(Server *server) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED) {
+                perror("accept");
+            }
+            if (errno != EINTR && errno != ECONNABORTED) {
+                return;
+            }
+            continue;
+        }
+
+        Connection *connection = malloc(sizeof(Connection));
+        if (connection == NULL || !setNonBlocking(fd)) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails harmlessly on Unix sockets
+        memset(connection, 0, offsetof(Connection, in));
+        connection->fd = fd;
+        connection->room = -1;
+        connection->watching = -1;
+        connection->playerId = server->nextPlayerId++;
+
+        struct epoll_event event = {EPOLLIN, {.ptr = connection}};
+        if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        server->stats.connections++;
+    }
+}
+
+// Queued replies first, then the spectator stream straight from the shared
+// buffers. Stops at a full socket buffer, false if the connection failed.
+static bool writeConnection(Server *server, Connection *connection) {
+    while (connection->outStart < connection->outEnd) {
+        ssize_t count = send(connection->fd, connection->out + connection->outStart, connection->outEnd - connection->outStart, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN;
+        }
+        connection->outStart += (size_t)count;
+    }
+    connection->outStart = 0;
+    connection->outEnd = 0;
+
+    while (connection->queueCount > 0) {
+        struct iovec iov[SPECTATOR_QUEUE];
+        for (int i = 0; i < connection->queueCount; i++) {
+            SharedBuffer *buffer = connection->queue[(connection->queueHead + i) % SPECTATOR_QUEUE];
+            size_t skip = i == 0 ? connection->queueOffset : 0;
+            iov[i].iov_base = buffer->data + skip;
+            iov[i].iov_len = buffer->size - skip;
+        }
+        ssize_t count = writev(connection->fd, iov, connection->queueCount);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN;
+        }
+        server->stats.fanoutBytes += (uint64_t)count;
+
+        size_t written = (size_t)count;
+        while (written > 0) {
+            SharedBuffer *head = connection->queue[connection->queueHead];
+            size_t left = head->size - connection->queueOffset;
+            if (written < left) {
+                connection->queueOffset += written;
+                break;
+            }
+            written -= left;
+            connection->queueOffset = 0;
+            connection->queueHead = (connection->queueHead + 1) % SPECTATOR_QUEUE;
+            connection->queueCount--;
+            releaseBuffer(head);
+        }
+    }
+    connection->resyncs = 0;
+    return true;
+}
+
+// Writes what each touched connection has queued, waiting for EPOLLOUT only
+// when the socket buffer is full, and closes dropped connections
+static void flushConnections(Server *server) {
+    while (server->flushList != NULL) {
+        Connection *connection = server->flushList;
+        server->flushList = connection->nextFlush;
+        connection->queued = false;
+
+        if (connection->closing) {
+            freeConnection(connection);
+            continue;
+        }
+        if (!writeConnection(server, connection)) {
+            leaveRoom(server, connection);
+            freeConnection(connection);
+            continue;
+        }
+
+        if (connection->outStart > 0) {
+            memmove(connection->out, connection->out + connection->outStart, connection->outEnd - connection->outStart);
+            connection->outEnd -= connection->outStart;
+            connection->outStart = 0;
+        }
+        bool pending = connection->outEnd > 0 || connection->queueCount > 0;
+        if (pending != connection->writing) {
+            struct epoll_event event = {pending ? EPOLLIN | EPOLLOUT : EPOLLIN, {.ptr = connection}};
+            epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+            connection->writing = pending;
+        }
+    }
+}
+
+static void printStats(const Server *server, double seconds) {
+    char arbitration[160];
+    formatHistogram(arbitration, sizeof(arbitration), "arbitration", &server->stats.arbitration);
+    fprintf(stderr, "connections: %llu  dropped: %llu  rounds: %llu  claims: %llu  gyuls: %llu  stale: %llu  errors: %llu  claims/sec: %.0f\n"
+            "spectators: %llu  resyncs: %llu  spectators dropped: %llu  delta bytes: %llu  fan-out bytes: %llu\n%s\n",
+            (unsigned long long)server->stats.connections, (unsigned long long)server->stats.dropped,
+            (unsigned long long)server->stats.rounds, (unsigned long long)server->stats.claims,
+            (unsigned long long)server->stats.gyuls, (unsigned long long)server->stats.stale,
+            (unsigned long long)server->stats.errors,
+            seconds > 0 ? server->stats.claims / seconds : 0.0,
+            (unsigned long long)server->stats.spectators, (unsigned long long)server->stats.resyncs,
+            (unsigned long long)server->stats.spectatorDrops, (unsigned long long)server->stats.publishedBytes,
+            (unsigned long long)server->stats.fanoutBytes, arbitration);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-a address] [-r rooms] [-g first game] [-S dir] [-v]\n"
+            "  -a  host:port or unix:path to listen on (default %s)\n"
+            "  -r  number of rooms, numbered from 0 (default %d)\n"
+            "  -g  game number of room 0's first round (default 0)\n"
+            "  -S  record every player's rounds in this stats directory\n"
+            "  -v  print stats every %d seconds\n",
+            program, NET_DEFAULT_ADDRESS, DEFAULT_ROOMS, STATS_SECONDS);
+}
+
+int main(int argc, char **argv) {
+    const char *address = NET_DEFAULT_ADDRESS;
+    Server server;
+    bool verbose = false;
+    const char *statsDir = NULL;
+    static StatsStore statsStore;
+
+    memset(&server, 0, sizeof(server));
+    server.numRooms = DEFAULT_ROOMS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            address = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            server.numRooms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            server.firstGame = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            statsDir = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    server.rooms = calloc(server.numRooms, sizeof(Room));
+    if (server.rooms == NULL) {
+        perror("rooms");
+        return 1;
+    }
+    resetHistogram(&server.stats.arbitration);
+    if (statsDir != NULL) {
+        if (!openStatsStore(&statsStore, statsDir)) {
+            perror(statsDir);
+            return 1;
+        }
+        server.statsStore = &statsStore;
+    }
+    server.nextPlayerId = (uint64_t)time(NULL) << 32; // Not reused by later runs
+
+    raiseFileLimit();
+    server.listener = listenOn(address);
+    if (server.listener < 0) {
+        perror(address);
+        return 1;
+    }
+    server.epoll = epoll_create1(0);
+    struct epoll_event listenEvent = {EPOLLIN, {.ptr = NULL}};
+    if (server.epoll < 0 || epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &listenEvent) != 0) {
+        perror("epoll");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "listening on %s, %u rooms\n", address, server.numRooms);
+
+    uint64_t start = monotonicNanos();
+    uint64_t lastStats = start;
+    struct epoll_event events[MAX_EVENTS];
+    while (!stopRequested) {
+        int numEvents = epoll_wait(server.epoll, events, MAX_EVENTS, server.statsStore != NULL ? STATS_SYNC_MILLIS : 1000);
+        if (numEvents < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int e = 0; e < numEvents; e++) {
+            Connection *connection = events[e].data.ptr;
+            if (connection == NULL) {
+                acceptConnections(&server);
+                continue;
+            }
+            if (connection->closing) {
+                continue;
+            }
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readConnection(&server, connection);
+            }
+            if ((events[e].events & EPOLLOUT) && !connection->closing) {
+                queueFlush(&server, connection);
+            }
+        }
+        publishPending(&server);
+        flushConnections(&server);
+        if (server.statsStore != NULL) {
+            flushStatsIfDue(server.statsStore);
+        }
+
+        uint64_t now = monotonicNanos();
+        if (verbose && now - lastStats >= STATS_SECONDS * 1000000000ULL) {
+            printStats(&server, (now - start) / 1e9);
+            lastStats = now;
+        }
+    }
+
+    printStats(&server, (monotonicNanos() - start) / 1e9);
+    if (server.statsStore != NULL) {
+        closeStatsStore(server.statsStore);
+        fprintf(stderr, "stats: %llu syncs%s\n", (unsigned long long)statsStore.syncs, statsStore.failed ? ", a write failed" : "");
+    }
+    close(server.listener);
+    close(server.epoll);
+    free(server.rooms);
+    return 0;
+}
@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_sim.h"
+#include "gyulhap_metrics.h"
+#include <string.h>
+#include <time.h>
+
+#define AWAIT_NANOS (SIM_TICK_NANOS / 8) // Renderer nap while a round is dealt
+
+void initSimulation(Simulation *sim, ReplayLog *replay, StatsStore *stats, uint64_t player) {
+    memset(sim, 0, sizeof(*sim));
+    sim->replay = replay;
+    sim->stats = stats;
+    sim->player = player;
+    sim->back = 0;
+    sim->middle = 1;
+    sim->front = 2;
+}
+
+static void logSim(Simulation *sim, ReplayType type, int position, int result, int scoreDelta, uint32_t board, uint64_t value) {
+    ReplayRecord record = {(uint8_t)type, (uint8_t)position, (uint8_t)result, (int8_t)scoreDelta, board, value};
+    if (sim->replay != NULL) {
+        logReplay(sim->replay, &record);
+    }
+}
+
+// Once per round, when it ends; the batch reaches disk on a later step
+static void recordRound(Simulation *sim) {
+    SimSnapshot *state = &sim->state;
+    StatsRecord record;
+    if (sim->stats != NULL) {
+        finishTally(&state->tally, state->game.score, !state->timedOut, state->endNanos, &record);
+        appendStats(sim->stats, &record);
+    }
+}
+
+// A timed round that reached its deadline by now ends there, with no GYUL
+static bool expireRound(Simulation *sim, uint64_t now) {
+    SimSnapshot *state = &sim->state;
+    if (state->deadline == 0 || state->endNanos != 0 || now < state->deadline) {
+        return false;
+    }
+    state->game.isGameOver = true;
+    state->timedOut = true;
+    state->endNanos = state->deadline;
+    state->remainingNanos = 0;
+    logSim(sim, REPLAY_TIMEOUT, 0, 0, 0, 0, state->deadline);
+    recordRound(sim);
+    return true;
+}
+
+static bool applyCommand(Simulation *sim, const SimCommand *command) {
+    SimSnapshot *state = &sim->state;
+    GameState *game = &state->game;
+    int before = game->score;
+
+    state->lastInput = command->time;
+    switch (command->type) {
+        case SIM_START:
+            startRound(game, command->tiles);
+            state->gameNumber = command->gameNumber;
+            state->round++;
+            state->timedOut = false;
+            state->deadline = command->timeLimitNanos ? command->time + command->timeLimitNanos : 0;
+            state->remainingNanos = command->timeLimitNanos;
+            state->endNanos = 0;
+            startTally(&state->tally, sim->player, command->gameNumber, game->numHaps, command->time);
+            logSim(sim, REPLAY_ROUND, 0, 0, 0, boardToMask(command->tiles, NUM_TILES), command->gameNumber);
+            if (state->deadline != 0) {
+                logSim(sim, REPLAY_DEADLINE, 0, 0, 0, 0, state->deadline);
+            }
+            return true;
+        case SIM_TOGGLE: {
+            if (game->isGameOver || command->position < 0 || command->position >= NUM_TILES) {
+                return false;
+            }
+            SubmitResult result = togglePosition(game, command->position);
+            tallyClaim(&state->tally, result, command->time);
+            logSim(sim, REPLAY_TOGGLE, command->position, result, game->score - before, 0, command->time);
+            return true;
+        }
+        case SIM_GYUL:
+            if (game->isGameOver) {
+                return false;
+            }
+            claimGyul(game);
+            tallyGyul(&state->tally, game->isGameOver);
+            if (game->isGameOver) {
+                state->endNanos = command->time;
+                recordRound(sim);
+            }
+            logSim(sim, REPLAY_GYUL, 0, game->isGameOver, game->score - before, 0, command->time);
+            return true;
+    }
+    return false;
+}
+
+// Fills the back slot and swaps it in as the middle one
+static void publishSnapshot(Simulation *sim) {
+    sim->slots[sim->back] = sim->state;
+    uint32_t previous = __atomic_exchange_n(&sim->middle, sim->back | SIM_FRESH, __ATOMIC_ACQ_REL);
+    sim->back = previous & ~(uint32_t)SIM_FRESH;
+}
+
+// One step up to stepEnd: every queued command in order, each after the
+// clock has been run up to its own stamp, then the clock up to stepEnd.
+// Publishes and returns true if anything changed.
+bool stepSimulation(Simulation *sim, uint64_t stepEnd) {
+    SimSnapshot *state = &sim->state;
+    uint64_t tail = sim->tail;
+    uint64_t head = __atomic_load_n(&sim->head, __ATOMIC_ACQUIRE);
+    bool changed = false;
+
+    while (tail != head) {
+        const SimCommand *command = &sim->commands[tail & (SIM_COMMAND_RING - 1)];
+        changed |= expireRound(sim, command->time);
+        changed |= applyCommand(sim, command);
+        tail++;
+    }
+    __atomic_store_n(&sim->tail, tail, __ATOMIC_RELEASE);
+
+    changed |= expireRound(sim, stepEnd);
+    if (state->deadline != 0 && state->endNanos == 0) {
+        state->remainingNanos = state->deadline - stepEnd;
+        changed = true;
+    }
+    if (sim->stats != NULL) {
+        flushStatsIfDue(sim->stats);
+    }
+    state->steps++;
+    if (changed) {
+        publishSnapshot(sim);
+    }
+    return changed;
+}
+
+// Steps on the tick boundaries; a step that overran skips the boundaries
+// it missed rather than running them back to back, since a step's outcome
+// depends only on the command stamps and its own end
+static void *runSimulation(void *arg) {
+    Simulation *sim = arg;
+    uint64_t next = monotonicNanos() + SIM_TICK_NANOS;
+
+    while (!__atomic_load_n(&sim->stopping, __ATOMIC_ACQUIRE)) {
+        uint64_t now = monotonicNanos();
+        if (now < next) {
+            struct timespec pause = {0, (long)(next - now)};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        stepSimulation(sim, next);
+        next += SIM_TICK_NANOS;
+
+        now = monotonicNanos();
+        if (now >= next + SIM_TICK_NANOS) {
+            uint64_t missed = (now - next) / SIM_TICK_NANOS;
+            sim->lateSteps += missed;
+            next += missed * SIM_TICK_NANOS;
+        }
+    }
+    return NULL;
+}
+
+bool startSimulation(Simulation *sim) {
+    sim->stopping = false;
+    sim->running = pthread_create(&sim->thread, NULL, runSimulation, sim) == 0;
+    return sim->running;
+}
+
+// Commands still queued are dropped with the thread, records still
+// buffered are left for closeStatsStore
+void stopSimulation(Simulation *sim) {
+    if (!sim->running) {
+        return;
+    }
+    __atomic_store_n(&sim->stopping, true, __ATOMIC_RELEASE);
+    pthread_join(sim->thread, NULL);
+    sim->running = false;
+}
+
+// Renderer only. Returns false, and counts the command as dropped, when the
+// simulation is a full ring behind.
+bool pushSimCommand(Simulation *sim, const SimCommand *command) {
+    if (sim->head - __atomic_load_n(&sim->tail, __ATOMIC_ACQUIRE) == SIM_COMMAND_RING) {
+        sim->dropped++;
+        return false;
+    }
+    sim->commands[sim->head & (SIM_COMMAND_RING - 1)] = *command;
+    __atomic_store_n(&sim->head, sim->head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Renderer only. The newest published state, which stays as it is until
+// the next call.
+const SimSnapshot *latestSnapshot(Simulation *sim) {
+    if (__atomic_load_n(&sim->middle, __ATOMIC_ACQUIRE) & SIM_FRESH) {
+        uint32_t previous = __atomic_exchange_n(&sim->middle, sim->front, __ATOMIC_ACQ_REL);
+        sim->front = previous & ~(uint32_t)SIM_FRESH;
+    }
+    return &sim->slots[sim->front];
+}
+
+// Renderer only, with the thread running: waits at most a step or so for
+// the first snapshot of a round just pushed
+const SimSnapshot *awaitSimRound(Simulation *sim, uint32_t round) {
+    struct timespec pause = {0, AWAIT_NANOS};
+    const SimSnapshot *snapshot = latestSnapshot(sim);
+    while (snapshot->round < round) {
+        nanosleep(&pause, NULL);
+        snapshot = latestSnapshot(sim);
+    }
+    return snapshot;
+}
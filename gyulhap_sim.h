@@ -0,0 +1,87 @@
+#ifndef GYULHAP_SIM_H
+#define GYULHAP_SIM_H
+
+#include "gyulhap_core.h"
+#include "gyulhap_replay.h"
+#include "gyulhap_stats.h"
+#include <pthread.h>
+
+// The rules on their own clock, apart from the frames that show them.
+//
+// The renderer turns presses into SimCommands stamped with the time they
+// were captured and pushes them on a single-producer single-consumer ring.
+// A simulation thread steps every SIM_TICK_NANOS on the monotonic clock:
+// each step applies the queued commands in order, then runs the Timed-mode
+// clock. Deadlines, hap times and replay timestamps all come from the
+// commands' own stamps, so they are the same whatever the frame rate or
+// however late a step ran. A round that ends, by GYUL or by the clock, is
+// appended to the stats store there too, and the store's batches are
+// flushed from the steps, so no fsync ever waits on a frame.
+//
+// Every step that changed something publishes a SimSnapshot through a
+// triple buffer: the simulation fills its back slot and swaps it with the
+// middle one, the renderer swaps the middle one for its front slot when it
+// is fresh. Neither side locks or waits, and the front slot is a whole,
+// immutable state until the renderer's next swap.
+//
+// stepSimulation is the whole of a step and needs no thread, so headless
+// tools run the same rules by calling it themselves.
+
+#define SIM_TICK_NANOS 4000000 // 250 steps a second
+#define SIM_COMMAND_RING 256 // Power of two
+#define SIM_FRESH 4 // Middle slot flag: published since the renderer's last swap
+
+typedef enum { SIM_START, SIM_TOGGLE, SIM_GYUL } SimCommandType;
+
+typedef struct {
+    SimCommandType type;
+    int position; // SIM_TOGGLE
+    uint64_t time; // Monotonic nanoseconds, when it happened
+    uint64_t timeLimitNanos; // SIM_START, 0 for an untimed round
+    uint64_t gameNumber; // SIM_START
+    TileId tiles[NUM_TILES]; // SIM_START
+} SimCommand;
+
+typedef struct {
+    GameState game;
+    RoundTally tally;
+    uint64_t gameNumber;
+    uint32_t round; // SIM_STARTs applied, 0 before the first
+    bool timedOut;
+    uint64_t deadline; // Monotonic nanoseconds, 0 if untimed
+    uint64_t remainingNanos; // Of a timed round, as of the last step
+    uint64_t endNanos; // When the round ended, 0 while it runs
+    uint64_t lastInput; // Stamp of the last command taken, applied or not
+    uint64_t steps;
+} SimSnapshot;
+
+typedef struct {
+    SimCommand commands[SIM_COMMAND_RING];
+    uint64_t head; // Next slot the renderer fills
+    char padding[64];
+    uint64_t tail; // Next slot the simulation takes
+    char padding2[64];
+    SimSnapshot slots[3];
+    uint32_t middle; // Slot index, plus SIM_FRESH
+    uint32_t back; // Simulation thread only
+    uint32_t front; // Renderer only
+    SimSnapshot state; // Simulation thread only
+    ReplayLog *replay; // NULL to not log
+    StatsStore *stats; // Finished rounds, NULL to not record
+    uint64_t player; // For the round tallies
+    uint64_t dropped; // Commands that found the ring full
+    uint64_t lateSteps; // Ticks skipped because a step ran late
+    bool stopping;
+    bool running; // The thread was started
+    pthread_t thread;
+} Simulation;
+
+void initSimulation(Simulation *sim, ReplayLog *replay, StatsStore *stats, uint64_t player);
+bool startSimulation(Simulation *sim);
+void stopSimulation(Simulation *sim);
+bool pushSimCommand(Simulation *sim, const SimCommand *command);
+bool stepSimulation(Simulation *sim, uint64_t stepEnd);
+const SimSnapshot *latestSnapshot(Simulation *sim);
+const SimSnapshot *awaitSimRound(Simulation *sim, uint32_t round);
+
+#endif
@@ -0,0 +1,163 @@
+#include "gyulhap_core.h"
+
+// countHapsMaskBatch scores many boards at once: each vector lane holds one
+// board and every line test is an and + compare, so the 117 tests run on
+// 8 (AVX2), 4 (SSE2 / NEON) boards per instruction. The kernel is picked at
+// runtime on x86 so one binary runs everywhere.
+//
+// validateHapsBatch checks packed triples the same way. Each tile becomes
+// a 9-bit code, one bit per attribute value. Three tiles are a hap exactly
+// when no attribute of a | b | c has two of its three bits set (all same
+// sets one, all different sets three). That needs one table load per tile
+// (an AVX2 gather) and a few shifts, adds and masks.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GYUL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define GYUL_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void countHapsScalar(const BoardMask *boards, uint8_t *counts, int numBoards) {
+    for (int b = 0; b < numBoards; b++) {
+        counts[b] = (uint8_t)countHapsMask(boards[b]);
+    }
+}
+
+#define VALUE_BITS 0x49u // Lowest bit of each attribute's 3-bit group
+
+// Bit (3 * attribute + value) set, attributes ordered color, shape, background
+static uint32_t TILE_VALUE_BITS[TOTAL_COMBINATIONS];
+
+__attribute__((constructor))
+static void initTileValueBits(void) {
+    for (int t = 0; t < TOTAL_COMBINATIONS; t++) {
+        TILE_VALUE_BITS[t] = (1u << (t % 3)) | (1u << (3 + (t / 3) % 3)) | (1u << (6 + t / 9));
+    }
+}
+
+static void validateHapsScalar(const uint32_t *triples, uint8_t *valid, int numTriples) {
+    for (int i = 0; i < numTriples; i++) {
+        uint32_t present = TILE_VALUE_BITS[triples[i] & 0xFF] | TILE_VALUE_BITS[(triples[i] >> 8) & 0xFF] | TILE_VALUE_BITS[(triples[i] >> 16) & 0xFF];
+        // Per-attribute count of values present, 1 to 3, then flag any 2
+        uint32_t values = (present & VALUE_BITS) + ((present >> 1) & VALUE_BITS) + ((present >> 2) & VALUE_BITS);
+        valid[i] = ((values >> 1) & ~values & VALUE_BITS) == 0;
+    }
+}
+
+#if GYUL_X86
+__attribute__((target("avx2")))
+static void validateHapsAvx2(const uint32_t *triples, uint8_t *valid, int numTriples) {
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i valueBits = _mm256_set1_epi32(VALUE_BITS);
+    const int *table = (const int *)TILE_VALUE_BITS;
+    int i = 0;
+
+    for (; i + 8 <= numTriples; i += 8) {
+        __m256i packed = _mm256_loadu_si256((const __m256i *)(triples + i));
+        __m256i present = _mm256_or_si256(
+            _mm256_or_si256(_mm256_i32gather_epi32(table, _mm256_and_si256(packed, byteMask), 4),
+                            _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(packed, 8), byteMask), 4)),
+            _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(packed, 16), byteMask), 4));
+        __m256i values = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(present, valueBits),
+                                                           _mm256_and_si256(_mm256_srli_epi32(present, 1), valueBits)),
+                                          _mm256_and_si256(_mm256_srli_epi32(present, 2), valueBits));
+        __m256i twos = _mm256_andnot_si256(values, _mm256_and_si256(_mm256_srli_epi32(values, 1), valueBits));
+        int validLanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(twos, _mm256_setzero_si256())));
+        for (int lane = 0; lane < 8; lane++) {
+            valid[i + lane] = (validLanes >> lane) & 1;
+        }
+    }
+    validateHapsScalar(triples + i, valid + i, numTriples - i);
+}
+
+__attribute__((target("avx2")))
+static void countHapsAvx2(const BoardMask *boards, uint8_t *counts, int numBoards) {
+    int b = 0;
+    for (; b + 8 <= numBoards; b += 8) {
+        __m256i board = _mm256_loadu_si256((const __m256i *)(boards + b));
+        __m256i numHaps = _mm256_setzero_si256();
+        for (int l = 0; l < NUM_LINES; l++) {
+            __m256i line = _mm256_set1_epi32((int)HAP_LINES[l]);
+            // Full match is all ones (-1), so subtracting adds 1
+            numHaps = _mm256_sub_epi32(numHaps, _mm256_cmpeq_epi32(_mm256_and_si256(board, line), line));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, numHaps);
+        for (int i = 0; i < 8; i++) {
+            counts[b + i] = (uint8_t)lanes[i];
+        }
+    }
+    countHapsScalar(boards + b, counts + b, numBoards - b);
+}
+
+__attribute__((target("sse2")))
+static void countHapsSse2(const BoardMask *boards, uint8_t *counts, int numBoards) {
+    int b = 0;
+    for (; b + 4 <= numBoards; b += 4) {
+        __m128i board = _mm_loadu_si128((const __m128i *)(boards + b));
+        __m128i numHaps = _mm_setzero_si128();
+        for (int l = 0; l < NUM_LINES; l++) {
+            __m128i line = _mm_set1_epi32((int)HAP_LINES[l]);
+            numHaps = _mm_sub_epi32(numHaps, _mm_cmpeq_epi32(_mm_and_si128(board, line), line));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, numHaps);
+        for (int i = 0; i < 4; i++) {
+            counts[b + i] = (uint8_t)lanes[i];
+        }
+    }
+    countHapsScalar(boards + b, counts + b, numBoards - b);
+}
+#endif
+
+#if GYUL_NEON
+static void countHapsNeon(const BoardMask *boards, uint8_t *counts, int numBoards) {
+    int b = 0;
+    for (; b + 4 <= numBoards; b += 4) {
+        uint32x4_t board = vld1q_u32(boards + b);
+        uint32x4_t numHaps = vdupq_n_u32(0);
+        for (int l = 0; l < NUM_LINES; l++) {
+            uint32x4_t line = vdupq_n_u32(HAP_LINES[l]);
+            numHaps = vsubq_u32(numHaps, vceqq_u32(vandq_u32(board, line), line));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, numHaps);
+        for (int i = 0; i < 4; i++) {
+            counts[b + i] = (uint8_t)lanes[i];
+        }
+    }
+    countHapsScalar(boards + b, counts + b, numBoards - b);
+}
+#endif
+
+void countHapsMaskBatch(const BoardMask *boards, uint8_t *counts, int numBoards) {
+#if GYUL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        countHapsAvx2(boards, counts, numBoards);
+    } else if (__builtin_cpu_supports("sse2")) {
+        countHapsSse2(boards, counts, numBoards);
+    } else {
+        countHapsScalar(boards, counts, numBoards);
+    }
+#elif GYUL_NEON
+    countHapsNeon(boards, counts, numBoards);
+#else
+    countHapsScalar(boards, counts, numBoards);
+#endif
+}
+
+// valid[i] is isValidHap of the three tiles packed in triples[i], each a
+// TileId below TOTAL_COMBINATIONS
+void validateHapsBatch(const uint32_t *triples, uint8_t *valid, int numTriples) {
+#if GYUL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        validateHapsAvx2(triples, valid, numTriples);
+        return;
+    }
+#endif
+    validateHapsScalar(triples, valid, numTriples);
+}
@@ -0,0 +1,596 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_stats.h"
+#include "gyulhap_metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK 4096 // Records per read while compacting
+#define FILE_PATH_MAX (STATS_PATH_MAX + 32) // The directory plus a file name
+
+// Bytes per row of each summary column
+static const size_t COLUMN_SIZES[NUM_STATS_COLUMNS] = {8, 4, 4, 8, 4, 4, 8, 8, 4, 4, 4};
+
+static uint32_t recordChecksum(const StatsRecord *record) {
+    const unsigned char *bytes = (const unsigned char *)record;
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < offsetof(StatsRecord, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void segmentPath(const char *dir, uint32_t segment, char *path) {
+    snprintf(path, FILE_PATH_MAX, "%s/%08u.seg", dir, segment);
+}
+
+static void summaryPath(const char *dir, char *path, const char *suffix) {
+    snprintf(path, FILE_PATH_MAX, "%s/summary.col%s", dir, suffix);
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t count = write(fd, bytes, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+// Fills buffer with up to count records, false on a read error
+static bool readRecords(int fd, StatsRecord *buffer, size_t count, size_t *numRead) {
+    size_t size = count * sizeof(StatsRecord);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t bytes = read(fd, (char *)buffer + done, size - done);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0) {
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+        done += (size_t)bytes;
+    }
+    *numRead = done / sizeof(StatsRecord);
+    return true;
+}
+
+void startTally(RoundTally *tally, uint64_t player, uint64_t gameNumber, int numHaps, uint64_t nowNanos) {
+    memset(tally, 0, sizeof(*tally));
+    tally->player = player;
+    tally->gameNumber = gameNumber;
+    tally->numHaps = numHaps;
+    tally->startNanos = nowNanos;
+    tally->lastHapNanos = nowNanos;
+}
+
+void tallyClaim(RoundTally *tally, SubmitResult result, uint64_t nowNanos) {
+    if (result == SUBMIT_HAP) {
+        uint64_t took = nowNanos - tally->lastHapNanos;
+        if (tally->haps == 0 || took < tally->bestHapNanos) {
+            tally->bestHapNanos = took;
+        }
+        tally->lastHapNanos = nowNanos;
+        tally->haps++;
+    } else if (result != SUBMIT_NONE) {
+        tally->wrongHaps++;
+    }
+}
+
+void tallyGyul(RoundTally *tally, bool won) {
+    if (won) {
+        tally->gyuls++;
+    } else {
+        tally->wrongGyuls++;
+    }
+}
+
+void finishTally(const RoundTally *tally, int score, bool finished, uint64_t nowNanos, StatsRecord *record) {
+    memset(record, 0, sizeof(*record));
+    record->player = tally->player;
+    record->gameNumber = tally->gameNumber;
+    record->score = score;
+    record->roundMillis = finished ? (uint32_t)((nowNanos - tally->startNanos) / 1000000) : STATS_NO_TIME;
+    record->bestHapMillis = tally->haps > 0 ? (uint32_t)(tally->bestHapNanos / 1000000) : STATS_NO_TIME;
+    record->haps = (uint8_t)tally->haps;
+    record->numHaps = (uint8_t)tally->numHaps;
+    record->gyuls = (uint8_t)tally->gyuls;
+    record->wrongGyuls = (uint8_t)tally->wrongGyuls;
+    record->wrongHaps = (uint32_t)tally->wrongHaps;
+}
+
+static bool openSegment(StatsStore *store, uint32_t segment) {
+    char path[FILE_PATH_MAX];
+    if (store->fd >= 0) {
+        fsync(store->fd);
+        close(store->fd);
+    }
+    segmentPath(store->dir, segment, path);
+    store->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    store->segment = segment;
+    store->segmentRecords = 0;
+    return store->fd >= 0;
+}
+
+// Appends to the newest segment after cutting off anything past its last
+// whole, intact record
+bool openStatsStore(StatsStore *store, const char *dir) {
+    char path[FILE_PATH_MAX];
+    struct stat info;
+
+    memset(store, 0, sizeof(*store));
+    store->fd = -1;
+    snprintf(store->dir, sizeof(store->dir), "%s", dir);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+
+    uint32_t segment = 0;
+    for (;;) {
+        segmentPath(dir, segment + 1, path);
+        if (stat(path, &info) != 0) {
+            break;
+        }
+        segment++;
+    }
+
+    segmentPath(dir, segment, path);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    uint64_t valid = 0;
+    StatsRecord chunk[READ_CHUNK];
+    size_t numRead;
+    bool intact = true;
+    while (intact && readRecords(fd, chunk, READ_CHUNK, &numRead) && numRead > 0) {
+        for (size_t r = 0; r < numRead && intact; r++) {
+            intact = chunk[r].checksum == recordChecksum(&chunk[r]);
+            valid += intact;
+        }
+    }
+    if (ftruncate(fd, (off_t)(valid * sizeof(StatsRecord))) != 0) {
+        close(fd);
+        return false;
+    }
+    fsync(fd);
+    close(fd);
+
+    if (!openSegment(store, segment)) {
+        return false;
+    }
+    store->segmentRecords = valid;
+    return true;
+}
+
+// Writes the batch, rolling over to a new segment when one fills up, then
+// one fsync for all of it
+bool flushStats(StatsStore *store) {
+    int written = 0;
+    while (!store->failed && written < store->buffered) {
+        if (store->segmentRecords == STATS_SEGMENT_RECORDS && !openSegment(store, store->segment + 1)) {
+            store->failed = true;
+            break;
+        }
+        uint64_t room = STATS_SEGMENT_RECORDS - store->segmentRecords;
+        int count = store->buffered - written < (int)room ? store->buffered - written : (int)room;
+        if (!writeAll(store->fd, &store->buffer[written], (size_t)count * sizeof(StatsRecord))) {
+            store->failed = true;
+            break;
+        }
+        written += count;
+        store->segmentRecords += (uint64_t)count;
+    }
+    if (!store->failed && written > 0) {
+        store->failed = fsync(store->fd) != 0;
+        store->syncs++;
+    }
+    store->buffered = 0;
+    return !store->failed;
+}
+
+// Buffers the record; the batch goes to disk once it is full or its oldest
+// record has waited STATS_SYNC_MILLIS
+bool appendStats(StatsStore *store, const StatsRecord *record) {
+    if (store->failed) {
+        return false;
+    }
+    if (store->buffered == 0) {
+        store->oldestBuffered = monotonicNanos();
+    }
+    StatsRecord *slot = &store->buffer[store->buffered++];
+    *slot = *record;
+    slot->checksum = recordChecksum(slot);
+
+    if (store->buffered == STATS_BATCH_RECORDS) {
+        return flushStats(store);
+    }
+    return flushStatsIfDue(store);
+}
+
+// For writers that go quiet: call it at least every STATS_SYNC_MILLIS
+bool flushStatsIfDue(StatsStore *store) {
+    if (store->buffered > 0 && monotonicNanos() - store->oldestBuffered >= STATS_SYNC_MILLIS * 1000000ULL) {
+        return flushStats(store);
+    }
+    return !store->failed;
+}
+
+void closeStatsStore(StatsStore *store) {
+    flushStats(store);
+    if (store->fd >= 0) {
+        close(store->fd);
+        store->fd = -1;
+    }
+}
+
+// Players by id while compacting: rows plus an open-addressed index
+typedef struct {
+    PlayerStats *rows;
+    uint32_t numRows;
+    uint32_t rowCapacity;
+    uint32_t *slots; // Row + 1, 0 is empty
+    uint32_t slotMask;
+} PlayerTable;
+
+static uint32_t hashPlayer(uint64_t player) {
+    player ^= player >> 33;
+    player *= 0xFF51AFD7ED558CCDULL;
+    return (uint32_t)(player ^ (player >> 33));
+}
+
+static bool growTable(PlayerTable *table) {
+    uint32_t slotCount = table->slotMask ? (table->slotMask + 1) * 2 : 1024;
+    uint32_t *slots = calloc(slotCount, sizeof(uint32_t));
+    PlayerStats *rows = realloc(table->rows, (size_t)(slotCount / 2) * sizeof(PlayerStats));
+    if (slots == NULL || rows == NULL) {
+        free(slots);
+        if (rows != NULL) {
+            table->rows = rows;
+        }
+        return false;
+    }
+    table->rows = rows;
+    table->rowCapacity = slotCount / 2;
+    free(table->slots);
+    table->slots = slots;
+    table->slotMask = slotCount - 1;
+
+    for (uint32_t r = 0; r < table->numRows; r++) {
+        uint32_t slot = hashPlayer(rows[r].player) & table->slotMask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & table->slotMask;
+        }
+        slots[slot] = r + 1;
+    }
+    return true;
+}
+
+static PlayerStats *findPlayer(PlayerTable *table, uint64_t player) {
+    if (table->numRows == table->rowCapacity && !growTable(table)) {
+        return NULL;
+    }
+    uint32_t slot = hashPlayer(player) & table->slotMask;
+    while (table->slots[slot] != 0) {
+        PlayerStats *row = &table->rows[table->slots[slot] - 1];
+        if (row->player == player) {
+            return row;
+        }
+        slot = (slot + 1) & table->slotMask;
+    }
+
+    PlayerStats *row = &table->rows[table->numRows++];
+    table->slots[slot] = table->numRows;
+    memset(row, 0, sizeof(*row));
+    row->player = player;
+    row->bestHapMillis = STATS_NO_TIME;
+    row->bestRoundMillis = STATS_NO_TIME;
+    return row;
+}
+
+static void applyRecord(PlayerStats *row, const StatsRecord *record) {
+    if (row->games == 0 || record->score > row->bestScore) {
+        row->bestScore = record->score;
+    }
+    row->games++;
+    row->totalScore += record->score;
+    if (record->bestHapMillis < row->bestHapMillis) {
+        row->bestHapMillis = record->bestHapMillis;
+    }
+    if (record->roundMillis < row->bestRoundMillis) {
+        row->bestRoundMillis = record->roundMillis;
+    }
+    row->hapsFound += record->haps;
+    row->hapsTotal += record->numHaps;
+    row->gyuls += record->gyuls;
+    row->wrongGyuls += record->wrongGyuls;
+}
+
+#define COLUMN(summary, type, column) ((const type *)((const char *)(summary)->data + (summary)->header->columnOffset[column]))
+
+static void readRow(const StatsSummary *summary, uint32_t row, PlayerStats *stats) {
+    stats->player = summary->players[row];
+    stats->games = COLUMN(summary, uint32_t, COLUMN_GAMES)[row];
+    stats->bestScore = COLUMN(summary, int32_t, COLUMN_BEST_SCORE)[row];
+    stats->totalScore = COLUMN(summary, int64_t, COLUMN_TOTAL_SCORE)[row];
+    stats->bestHapMillis = COLUMN(summary, uint32_t, COLUMN_BEST_HAP)[row];
+    stats->bestRoundMillis = COLUMN(summary, uint32_t, COLUMN_BEST_ROUND)[row];
+    stats->hapsFound = COLUMN(summary, uint64_t, COLUMN_HAPS_FOUND)[row];
+    stats->hapsTotal = COLUMN(summary, uint64_t, COLUMN_HAPS_TOTAL)[row];
+    stats->gyuls = COLUMN(summary, uint32_t, COLUMN_GYULS)[row];
+    stats->wrongGyuls = COLUMN(summary, uint32_t, COLUMN_WRONG_GYULS)[row];
+}
+
+static int comparePlayers(const void *a, const void *b) {
+    uint64_t x = ((const PlayerStats *)a)->player;
+    uint64_t y = ((const PlayerStats *)b)->player;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    int32_t bestScore;
+    uint32_t row;
+} LeaderEntry;
+
+// Best score first, ties to the lower row (lower player id)
+static int compareLeaders(const void *a, const void *b) {
+    const LeaderEntry *x = a;
+    const LeaderEntry *y = b;
+    if (x->bestScore != y->bestScore) {
+        return x->bestScore > y->bestScore ? -1 : 1;
+    }
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+// Column c is the field at offset fieldOffset, size bytes wide, of every row
+static bool writeColumn(FILE *out, const PlayerTable *table, size_t fieldOffset, size_t size) {
+    for (uint32_t r = 0; r < table->numRows; r++) {
+        if (fwrite((const char *)&table->rows[r] + fieldOffset, size, 1, out) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeSummary(const char *dir, const PlayerTable *table, const LeaderEntry *leaders, uint32_t segment, uint64_t record) {
+    static const size_t OFFSETS[COLUMN_LEADERBOARD] = {
+        offsetof(PlayerStats, player), offsetof(PlayerStats, games), offsetof(PlayerStats, bestScore),
+        offsetof(PlayerStats, totalScore), offsetof(PlayerStats, bestHapMillis), offsetof(PlayerStats, bestRoundMillis),
+        offsetof(PlayerStats, hapsFound), offsetof(PlayerStats, hapsTotal), offsetof(PlayerStats, gyuls),
+        offsetof(PlayerStats, wrongGyuls)};
+    char tmpPath[FILE_PATH_MAX];
+    char path[FILE_PATH_MAX];
+
+    StatsSummaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STATS_SUMMARY_MAGIC, sizeof(header.magic));
+    header.numPlayers = table->numRows;
+    header.throughSegment = segment;
+    header.throughRecord = record;
+    uint64_t offset = sizeof(header);
+    for (int c = 0; c < NUM_STATS_COLUMNS; c++) {
+        header.columnOffset[c] = offset;
+        offset += ((uint64_t)table->numRows * COLUMN_SIZES[c] + 7) & ~7ULL; // 8-byte aligned columns
+    }
+
+    summaryPath(dir, tmpPath, ".tmp");
+    summaryPath(dir, path, "");
+    FILE *out = fopen(tmpPath, "wb");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (int c = 0; c < NUM_STATS_COLUMNS && ok; c++) {
+        if (c == COLUMN_LEADERBOARD) {
+            for (uint32_t r = 0; r < table->numRows && ok; r++) {
+                ok = fwrite(&leaders[r].row, sizeof(uint32_t), 1, out) == 1;
+            }
+        } else {
+            ok = writeColumn(out, table, OFFSETS[c], COLUMN_SIZES[c]);
+        }
+        uint64_t padding = (8 - ((uint64_t)table->numRows * COLUMN_SIZES[c]) % 8) % 8;
+        ok = ok && fwrite("\0\0\0\0\0\0\0", 1, padding, out) == padding;
+    }
+    ok = fflush(out) == 0 && fsync(fileno(out)) == 0 && ok;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return false;
+    }
+
+    // Make the rename itself durable
+    int dirFd = open(dir, O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    return true;
+}
+
+// Folds the log records written since the last compaction into a new
+// summary. Stops at the first torn record, which a later run picks up once
+// its writer has finished it.
+bool compactStats(const char *dir, uint64_t *compacted) {
+    PlayerTable table = {NULL, 0, 0, NULL, 0};
+    StatsSummary previous;
+    uint32_t segment = 0;
+    uint64_t record = 0;
+    uint64_t numCompacted = 0;
+    bool ok = growTable(&table);
+
+    if (ok && openStatsSummary(&previous, dir)) {
+        for (uint32_t r = 0; r < previous.header->numPlayers && ok; r++) {
+            PlayerStats *row = findPlayer(&table, previous.players[r]);
+            ok = row != NULL;
+            if (ok) {
+                readRow(&previous, r, row);
+            }
+        }
+        segment = previous.header->throughSegment;
+        record = previous.header->throughRecord;
+        closeStatsSummary(&previous);
+    }
+
+    StatsRecord *chunk = malloc(READ_CHUNK * sizeof(StatsRecord));
+    ok = ok && chunk != NULL;
+    bool intact = true;
+    while (ok && intact) {
+        char path[FILE_PATH_MAX];
+        segmentPath(dir, segment, path);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            break;
+        }
+        // Only fold in what a crash can't take back
+        if (fsync(fd) != 0 || lseek(fd, (off_t)(record * sizeof(StatsRecord)), SEEK_SET) < 0) {
+            close(fd);
+            ok = false;
+            break;
+        }
+
+        size_t numRead;
+        while (ok && intact && (ok = readRecords(fd, chunk, READ_CHUNK, &numRead)) && numRead > 0) {
+            for (size_t r = 0; r < numRead && intact && ok; r++) {
+                intact = chunk[r].checksum == recordChecksum(&chunk[r]);
+                if (intact) {
+                    PlayerStats *row = findPlayer(&table, chunk[r].player);
+                    ok = row != NULL;
+                    if (ok) {
+                        applyRecord(row, &chunk[r]);
+                        record++;
+                        numCompacted++;
+                    }
+                }
+            }
+        }
+        close(fd);
+
+        // Only a full segment is followed by another
+        if (!intact || record < STATS_SEGMENT_RECORDS) {
+            break;
+        }
+        segment++;
+        record = 0;
+    }
+    free(chunk);
+
+    LeaderEntry *leaders = NULL;
+    if (ok) {
+        qsort(table.rows, table.numRows, sizeof(PlayerStats), comparePlayers);
+        leaders = malloc(((size_t)table.numRows + 1) * sizeof(LeaderEntry));
+        ok = leaders != NULL;
+    }
+    if (ok) {
+        for (uint32_t r = 0; r < table.numRows; r++) {
+            leaders[r].bestScore = table.rows[r].bestScore;
+            leaders[r].row = r;
+        }
+        qsort(leaders, table.numRows, sizeof(LeaderEntry), compareLeaders);
+        ok = writeSummary(dir, &table, leaders, segment, record);
+    }
+
+    free(leaders);
+    free(table.rows);
+    free(table.slots);
+    if (compacted != NULL) {
+        *compacted = numCompacted;
+    }
+    return ok;
+}
+
+bool openStatsSummary(StatsSummary *summary, const char *dir) {
+    char path[FILE_PATH_MAX];
+    struct stat info;
+
+    memset(summary, 0, sizeof(*summary));
+    summaryPath(dir, path, "");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(StatsSummaryHeader)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const StatsSummaryHeader *header = data;
+    bool valid = memcmp(header->magic, STATS_SUMMARY_MAGIC, sizeof(header->magic)) == 0;
+    for (int c = 0; c < NUM_STATS_COLUMNS && valid; c++) {
+        valid = header->columnOffset[c] % 8 == 0 &&
+                header->columnOffset[c] + (uint64_t)header->numPlayers * COLUMN_SIZES[c] <= (uint64_t)info.st_size;
+    }
+    if (!valid) {
+        munmap(data, (size_t)info.st_size);
+        return false;
+    }
+
+    summary->data = data;
+    summary->size = (size_t)info.st_size;
+    summary->header = header;
+    summary->players = COLUMN(summary, uint64_t, COLUMN_PLAYER);
+    summary->leaderboard = COLUMN(summary, uint32_t, COLUMN_LEADERBOARD);
+    return true;
+}
+
+void closeStatsSummary(StatsSummary *summary) {
+    if (summary->data != NULL) {
+        munmap(summary->data, summary->size);
+    }
+    memset(summary, 0, sizeof(*summary));
+}
+
+// Binary search on the sorted player column
+bool personalBest(const StatsSummary *summary, uint64_t player, PlayerStats *stats) {
+    if (summary->data == NULL) {
+        return false;
+    }
+    uint32_t low = 0;
+    uint32_t high = summary->header->numPlayers;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (summary->players[middle] < player) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == summary->header->numPlayers || summary->players[low] != player) {
+        return false;
+    }
+    readRow(summary, low, stats);
+    return true;
+}
+
+// The top count players by best score, fewer if there aren't that many
+int leaderboard(const StatsSummary *summary, int count, PlayerStats *stats) {
+    if (summary->data == NULL) {
+        return 0;
+    }
+    if ((uint32_t)count > summary->header->numPlayers) {
+        count = (int)summary->header->numPlayers;
+    }
+    for (int i = 0; i < count; i++) {
+        readRow(summary, summary->leaderboard[i], &stats[i]);
+    }
+    return count;
+}
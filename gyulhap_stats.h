@@ -0,0 +1,131 @@
+#ifndef GYULHAP_STATS_H
+#define GYULHAP_STATS_H
+
+#include "gyulhap_core.h"
+#include <stddef.h>
+
+// Per-player results that outlive the round.
+//
+// Writes go to an append-only log of segment files, dir/NNNNNNNN.seg, each
+// a plain array of StatsRecord. Records are buffered and written with one
+// fsync per batch, at most STATS_SYNC_MILLIS after the oldest one arrived,
+// so a crash loses at most that window. Every record carries a checksum
+// and a torn tail is cut off when the log is reopened.
+//
+// compactStats folds the records since the last compaction into
+// dir/summary.col: one column per PlayerStats field, rows sorted by player,
+// plus a leaderboard column of row numbers by best score. The summary is
+// replaced by rename and read through mmap, so a personal best is a binary
+// search and the top k are the first k rows of the leaderboard, whatever
+// the size of the history.
+
+#define STATS_DIR "gyulhap.stats"
+#define STATS_SUMMARY_MAGIC "GYULSUM1"
+#define STATS_BATCH_RECORDS 1024
+#define STATS_SYNC_MILLIS 200
+#define STATS_SEGMENT_RECORDS (1 << 20)
+#define STATS_PATH_MAX 256
+#define STATS_NO_TIME UINT32_MAX
+
+typedef struct {
+    uint64_t player;
+    uint64_t gameNumber;
+    int32_t score;
+    uint32_t roundMillis; // Deal to end, STATS_NO_TIME if the round wasn't finished
+    uint32_t bestHapMillis; // Fastest find, from the round start or the previous hap
+    uint8_t haps; // Found by this player
+    uint8_t numHaps; // On the board
+    uint8_t gyuls; // Right calls
+    uint8_t wrongGyuls;
+    uint32_t wrongHaps; // Wrong and repeated claims
+    uint32_t checksum; // Of everything above
+} StatsRecord;
+
+// A round in progress, turned into a StatsRecord at the end
+typedef struct {
+    uint64_t player;
+    uint64_t gameNumber;
+    uint64_t startNanos;
+    uint64_t lastHapNanos;
+    uint64_t bestHapNanos;
+    int haps;
+    int numHaps;
+    int wrongHaps;
+    int gyuls;
+    int wrongGyuls;
+} RoundTally;
+
+typedef struct {
+    char dir[STATS_PATH_MAX];
+    int fd; // Current segment
+    uint32_t segment;
+    uint64_t segmentRecords;
+    StatsRecord buffer[STATS_BATCH_RECORDS];
+    int buffered;
+    uint64_t oldestBuffered; // monotonicNanos of buffer[0]
+    uint64_t syncs;
+    bool failed; // A write failed, later records are discarded
+} StatsStore;
+
+typedef struct {
+    uint64_t player;
+    uint32_t games;
+    int32_t bestScore;
+    int64_t totalScore;
+    uint32_t bestHapMillis;
+    uint32_t bestRoundMillis;
+    uint64_t hapsFound;
+    uint64_t hapsTotal;
+    uint32_t gyuls;
+    uint32_t wrongGyuls;
+} PlayerStats;
+
+typedef enum {
+    COLUMN_PLAYER,
+    COLUMN_GAMES,
+    COLUMN_BEST_SCORE,
+    COLUMN_TOTAL_SCORE,
+    COLUMN_BEST_HAP,
+    COLUMN_BEST_ROUND,
+    COLUMN_HAPS_FOUND,
+    COLUMN_HAPS_TOTAL,
+    COLUMN_GYULS,
+    COLUMN_WRONG_GYULS,
+    COLUMN_LEADERBOARD, // Row numbers, best score first
+    NUM_STATS_COLUMNS
+} StatsColumn;
+
+typedef struct {
+    char magic[8];
+    uint32_t numPlayers;
+    uint32_t throughSegment; // Log records before (throughSegment, throughRecord) are included
+    uint64_t throughRecord;
+    uint64_t columnOffset[NUM_STATS_COLUMNS];
+} StatsSummaryHeader;
+
+typedef struct {
+    void *data;
+    size_t size;
+    const StatsSummaryHeader *header;
+    const uint64_t *players;
+    const uint32_t *leaderboard;
+} StatsSummary;
+
+void startTally(RoundTally *tally, uint64_t player, uint64_t gameNumber, int numHaps, uint64_t nowNanos);
+void tallyClaim(RoundTally *tally, SubmitResult result, uint64_t nowNanos);
+void tallyGyul(RoundTally *tally, bool won);
+void finishTally(const RoundTally *tally, int score, bool finished, uint64_t nowNanos, StatsRecord *record);
+
+bool openStatsStore(StatsStore *store, const char *dir);
+bool appendStats(StatsStore *store, const StatsRecord *record);
+bool flushStats(StatsStore *store);
+bool flushStatsIfDue(StatsStore *store);
+void closeStatsStore(StatsStore *store);
+
+bool compactStats(const char *dir, uint64_t *compacted);
+bool openStatsSummary(StatsSummary *summary, const char *dir);
+void closeStatsSummary(StatsSummary *summary);
+bool personalBest(const StatsSummary *summary, uint64_t player, PlayerStats *stats);
+int leaderboard(const StatsSummary *summary, int count, PlayerStats *stats);
+
+#endif
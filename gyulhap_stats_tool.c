@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gyulhap_stats.h"
+#include "gyulhap_metrics.h"
+#include "gyulhap_rng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compacts a stats store and answers queries from the summary.
+//
+// -w appends simulated rounds first, spread over -n players, to measure
+// the write rate through the same batching as the game and the server.
+// Every query is timed: they read the mmap'd summary, never the log.
+
+#define DEFAULT_PLAYERS 1000
+#define DEFAULT_TOP 10
+#define QUERY_REPEATS 100000
+
+static void simulateRecord(StatsRecord *record, uint64_t numPlayers, uint64_t gameNumber, GyulRng *rng) {
+    uint64_t draw = nextRng(rng);
+    memset(record, 0, sizeof(*record));
+    record->player = draw % numPlayers;
+    record->gameNumber = gameNumber;
+    record->numHaps = 1 + (draw >> 20) % 8;
+    record->haps = (draw >> 24) % (record->numHaps + 1);
+    record->wrongHaps = (draw >> 28) % 3;
+    record->gyuls = record->haps == record->numHaps;
+    record->wrongGyuls = (draw >> 32) % 4 == 0;
+    record->score = record->haps + 3 * record->gyuls - record->wrongHaps - record->wrongGyuls;
+    record->roundMillis = record->gyuls ? 5000 + (draw >> 36) % 60000 : STATS_NO_TIME;
+    record->bestHapMillis = record->haps ? 400 + (draw >> 44) % 8000 : STATS_NO_TIME;
+}
+
+static void printStats(const PlayerStats *stats) {
+    printf("%20llu  games: %u  best: %d  mean: %.2f", (unsigned long long)stats->player, stats->games, stats->bestScore,
+           stats->games ? (double)stats->totalScore / stats->games : 0.0);
+    if (stats->bestHapMillis != STATS_NO_TIME) {
+        printf("  fastest hap: %.3fs", stats->bestHapMillis / 1e3);
+    }
+    if (stats->bestRoundMillis != STATS_NO_TIME) {
+        printf("  fastest round: %.3fs", stats->bestRoundMillis / 1e3);
+    }
+    printf("  found: %llu/%llu  gyul: %u/%u\n", (unsigned long long)stats->hapsFound, (unsigned long long)stats->hapsTotal,
+           stats->gyuls, stats->gyuls + stats->wrongGyuls);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-d dir] [-w rounds] [-n players] [-k top] [-p player]\n"
+            "  -d  stats directory (default " STATS_DIR ")\n"
+            "  -w  append this many simulated rounds first\n"
+            "  -n  players in the simulated rounds (default %d)\n"
+            "  -k  leaderboard size (default %d)\n"
+            "  -p  also show this player's stats\n",
+            program, DEFAULT_PLAYERS, DEFAULT_TOP);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = STATS_DIR;
+    unsigned long long numSimulated = 0;
+    uint64_t numPlayers = DEFAULT_PLAYERS;
+    int top = DEFAULT_TOP;
+    bool showPlayer = false;
+    uint64_t player = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            numSimulated = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            numPlayers = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            showPlayer = true;
+            player = strtoull(argv[++i], NULL, 0);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (numPlayers < 1) {
+        numPlayers = 1;
+    }
+    if (top < 0) {
+        top = 0;
+    }
+
+    if (numSimulated > 0) {
+        static StatsStore store;
+        StatsRecord record;
+        GyulRng rng;
+        if (!openStatsStore(&store, dir)) {
+            perror(dir);
+            return 1;
+        }
+        seedRng(&rng, monotonicNanos());
+        uint64_t start = monotonicNanos();
+        for (unsigned long long r = 0; r < numSimulated; r++) {
+            simulateRecord(&record, numPlayers, r, &rng);
+            appendStats(&store, &record);
+        }
+        closeStatsStore(&store);
+        double elapsed = (monotonicNanos() - start) / 1e9;
+        fprintf(stderr, "appended: %llu  syncs: %llu  seconds: %.3f  records/sec: %.0f%s\n", numSimulated,
+                (unsigned long long)store.syncs, elapsed, elapsed > 0 ? numSimulated / elapsed : 0.0,
+                store.failed ? "  (write failed)" : "");
+    }
+
+    uint64_t compacted;
+    uint64_t start = monotonicNanos();
+    if (!compactStats(dir, &compacted)) {
+        perror(dir);
+        return 1;
+    }
+    double elapsed = (monotonicNanos() - start) / 1e9;
+
+    StatsSummary summary;
+    if (!openStatsSummary(&summary, dir)) {
+        fprintf(stderr, "%s: no stats summary\n", dir);
+        return 1;
+    }
+    printf("%s: %u players  compacted: %llu records in %.3f seconds\n", dir, summary.header->numPlayers,
+           (unsigned long long)compacted, elapsed);
+
+    PlayerStats *best = malloc(((size_t)top + 1) * sizeof(PlayerStats));
+    if (best == NULL) {
+        perror("leaderboard");
+        return 1;
+    }
+    start = monotonicNanos();
+    int count = 0;
+    for (int q = 0; q < QUERY_REPEATS; q++) {
+        count = leaderboard(&summary, top, best);
+    }
+    double leaderNanos = (double)(monotonicNanos() - start) / QUERY_REPEATS;
+    for (int i = 0; i < count; i++) {
+        printf("%3d. ", i + 1);
+        printStats(&best[i]);
+    }
+
+    double bestNanos = 0;
+    if (showPlayer) {
+        PlayerStats stats;
+        bool found = false;
+        start = monotonicNanos();
+        for (int q = 0; q < QUERY_REPEATS; q++) {
+            found = personalBest(&summary, player, &stats);
+        }
+        bestNanos = (double)(monotonicNanos() - start) / QUERY_REPEATS;
+        if (found) {
+            printf("you: ");
+            printStats(&stats);
+        } else {
+            printf("no rounds for player %llu\n", (unsigned long long)player);
+        }
+    }
+    printf("top %d: %.0f ns%s", count, leaderNanos, showPlayer ? "" : "\n");
+    if (showPlayer) {
+        printf("  personal best: %.0f ns\n", bestNanos);
+    }
+
+    free(best);
+    closeStatsSummary(&summary);
+    return 0;
+}